@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include <ns3/ai-module.h>
+#include <ns3/core-module.h>
+
+#include <iostream>
+
+namespace ns3
+{
+
+class ApbEnv : public OpenGymEnv
+{
+  public:
+    ApbEnv();
+    ~ApbEnv() override;
+    static TypeId GetTypeId();
+    void DoDispose() override;
+
+    /**
+     * Schedules the steps of an episode, whose random numbers are drawn
+     * with the seed and run of the episode
+     */
+    void Start(uint32_t steps);
+
+    // OpenGym interfaces:
+    Ptr<OpenGymSpace> GetActionSpace() override;
+    Ptr<OpenGymSpace> GetObservationSpace() override;
+    bool GetGameOver() override;
+    Ptr<OpenGymDataContainer> GetObservation() override;
+    float GetReward() override;
+    std::string GetExtraInfo() override;
+    bool ExecuteActions(Ptr<OpenGymDataContainer> action) override;
+
+  private:
+    void Step();
+
+    Ptr<UniformRandomVariable> m_rand;
+    uint32_t m_a;
+    uint32_t m_b;
+    uint32_t m_sum;
+};
+
+ApbEnv::ApbEnv()
+    : m_a(0),
+      m_b(0),
+      m_sum(0)
+{
+    SetOpenGymInterface(OpenGymInterface::Get());
+}
+
+ApbEnv::~ApbEnv()
+{
+}
+
+TypeId
+ApbEnv::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::ApbEpisodesEnv").SetParent<OpenGymEnv>().SetGroupName("OpenGym");
+    return tid;
+}
+
+void
+ApbEnv::DoDispose()
+{
+}
+
+void
+ApbEnv::Start(uint32_t steps)
+{
+    // created after the seed and run of the episode are set, which its stream derives from
+    m_rand = CreateObject<UniformRandomVariable>();
+    std::cout << "episode: seed " << RngSeedManager::GetSeed() << ", run "
+              << RngSeedManager::GetRun() << ", " << steps << " steps\n";
+    for (uint32_t i = 0; i < steps; ++i)
+    {
+        Simulator::Schedule(MilliSeconds(i), &ApbEnv::Step, this);
+    }
+}
+
+void
+ApbEnv::Step()
+{
+    m_a = m_rand->GetInteger(1, 10);
+    m_b = m_rand->GetInteger(1, 10);
+    std::cout << "set: " << m_a << "," << m_b << ";";
+    std::cout << "\n";
+
+    Notify();
+
+    std::cout << "get: " << m_sum << ";";
+    std::cout << "\n";
+}
+
+Ptr<OpenGymSpace>
+ApbEnv::GetActionSpace()
+{
+    std::vector<uint32_t> shape = {1};
+    std::string dtype = TypeNameGet<uint32_t>();
+    Ptr<OpenGymBoxSpace> box = CreateObject<OpenGymBoxSpace>(0, 20, shape, dtype);
+    return box;
+}
+
+Ptr<OpenGymSpace>
+ApbEnv::GetObservationSpace()
+{
+    std::vector<uint32_t> shape = {2};
+    std::string dtype = TypeNameGet<uint32_t>();
+    Ptr<OpenGymBoxSpace> box = CreateObject<OpenGymBoxSpace>(0, 10, shape, dtype);
+    return box;
+}
+
+bool
+ApbEnv::GetGameOver()
+{
+    // an episode ends when its steps have run out
+    return false;
+}
+
+Ptr<OpenGymDataContainer>
+ApbEnv::GetObservation()
+{
+    std::vector<uint32_t> shape = {2};
+    Ptr<OpenGymBoxContainer<uint32_t>> box =
+        m_openGymInterface->GetPooledContainer<OpenGymBoxContainer<uint32_t>>();
+    box->SetShape(shape);
+
+    box->AddValue(m_a);
+    box->AddValue(m_b);
+
+    return box;
+}
+
+float
+ApbEnv::GetReward()
+{
+    return 0.0;
+}
+
+std::string
+ApbEnv::GetExtraInfo()
+{
+    return "";
+}
+
+bool
+ApbEnv::ExecuteActions(Ptr<OpenGymDataContainer> action)
+{
+    Ptr<OpenGymBoxContainer<uint32_t>> box = DynamicCast<OpenGymBoxContainer<uint32_t>>(action);
+    m_sum = box->GetValue(0);
+    return true;
+}
+
+} // namespace ns3
+
+using namespace ns3;
+
+static uint32_t g_steps = 100; //!< steps of an episode without the steps parameter
+static Ptr<ApbEnv> g_apb;      //!< environment of the current episode
+
+/**
+ * Builds the environment of an episode served by RunEpisodes, with the
+ * number of steps given by the steps parameter, if any
+ */
+void
+BuildScenario(const OpenGymInterface::EpisodeParams& params)
+{
+    auto it = params.find("steps");
+    uint32_t steps = it == params.end() ? g_steps : std::stoul(it->second);
+    g_apb = CreateObject<ApbEnv>();
+    g_apb->Start(steps);
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::string server = "run";
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("server", "How episodes are served, run (RunEpisodes) or fork", server);
+    cmd.AddValue("steps", "Number of steps of an episode", g_steps);
+    cmd.Parse(argc, argv);
+    NS_ABORT_MSG_IF(server != "run" && server != "fork", "Unknown server " << server);
+
+    if (server == "run")
+    {
+        // the environment is built again for each episode, in this process, which never returns
+        OpenGymInterface::Get()->RunEpisodes(MakeCallback(&BuildScenario));
+    }
+
+    // the environment is built once, and each episode runs in a child process
+    g_apb = CreateObject<ApbEnv>();
+    g_apb->ForkEpisodes();
+    g_apb->Start(g_steps);
+    Simulator::Run();
+    g_apb->NotifySimulationEnd();
+    Simulator::Destroy();
+
+    return 0;
+}
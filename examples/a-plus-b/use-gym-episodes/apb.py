@@ -0,0 +1,91 @@
+# Copyright (c) 2023 Huazhong University of Science and Technology
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#
+# Author: Muyuan Shen <muyuan_shen@hust.edu.cn>
+
+
+
+import ns3ai_gym_env
+import gymnasium as gym
+import argparse
+import sys
+import traceback
+
+
+class ApbAgent:
+
+    def __init__(self):
+        pass
+
+    def get_action(self, obs, reward, done, info):
+
+        a = obs[0]
+        b = obs[1]
+        act = a + b
+
+        return [act]
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--fork', action='store_true',
+                    help='fork a process per episode instead of running them all in one')
+parser.add_argument('--episodes', type=int, default=5,
+                    help='number of episodes')
+args = parser.parse_args()
+
+env = gym.make("ns3ai_gym_env/Ns3-v0", targetName="ns3ai_apb_gym_episodes",
+               ns3Path="../../../../../", ns3Settings={"server": "fork" if args.fork else "run"})
+ob_space = env.observation_space
+ac_space = env.action_space
+print("Observation space: ", ob_space, ob_space.dtype)
+print("Action space: ", ac_space, ac_space.dtype)
+
+try:
+    agent = ApbAgent()
+
+    for episode in range(args.episodes):
+        # the first episode starts with the simulation, with the default steps. The simulation
+        # starts the next ones instead of running again, each with its own run, and RunEpisodes
+        # builds them with the options other than the run
+        options = {} if args.fork else {"steps": 10 * (episode + 1)}
+        obs, info = env.reset(options=options)
+        reward = 0
+        done = False
+        steps = 0
+
+        while True:
+
+            action = agent.get_action(obs, reward, info, done)
+
+            obs, reward, done, _, info = env.step(action)
+            steps += 1
+
+            if done:
+                break
+
+        print("Episode {} is over after {} steps".format(episode, steps))
+
+except Exception as e:
+    exc_type, exc_value, exc_traceback = sys.exc_info()
+    print("Exception occurred: {}".format(e))
+    print("Traceback:")
+    traceback.print_tb(exc_traceback)
+    exit(1)
+
+else:
+    pass
+
+finally:
+    print("Finally exiting...")
+    env.close()
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include <ns3/ai-module.h>
+#include <ns3/core-module.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#define NUM_ENV 10000
+#define APB_SIZE 3
+
+namespace ns3
+{
+
+/**
+ * \brief One of the agents, which is not connected to the interface
+ * itself but registered in an OpenGymMultiAgentEnv
+ */
+class ApbAgent : public OpenGymEnv
+{
+  public:
+    ApbAgent();
+    ~ApbAgent() override;
+    static TypeId GetTypeId();
+
+    // OpenGym interfaces:
+    Ptr<OpenGymSpace> GetActionSpace() override;
+    Ptr<OpenGymSpace> GetObservationSpace() override;
+    bool GetGameOver() override;
+    Ptr<OpenGymDataContainer> GetObservation() override;
+    float GetReward() override;
+    std::string GetExtraInfo() override;
+    bool ExecuteActions(Ptr<OpenGymDataContainer> action) override;
+
+    uint32_t m_a;
+    uint32_t m_b;
+    uint32_t m_sum;
+};
+
+ApbAgent::ApbAgent()
+{
+}
+
+ApbAgent::~ApbAgent()
+{
+}
+
+TypeId
+ApbAgent::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::ApbAgent").SetParent<OpenGymEnv>().SetGroupName("OpenGym");
+    return tid;
+}
+
+Ptr<OpenGymSpace>
+ApbAgent::GetActionSpace()
+{
+    std::vector<uint32_t> shape = {1};
+    std::string dtype = TypeNameGet<uint32_t>();
+    Ptr<OpenGymBoxSpace> box = CreateObject<OpenGymBoxSpace>(0, 20, shape, dtype);
+    return box;
+}
+
+Ptr<OpenGymSpace>
+ApbAgent::GetObservationSpace()
+{
+    std::vector<uint32_t> shape = {2};
+    std::string dtype = TypeNameGet<uint32_t>();
+    Ptr<OpenGymBoxSpace> box = CreateObject<OpenGymBoxSpace>(0, 10, shape, dtype);
+    return box;
+}
+
+bool
+ApbAgent::GetGameOver()
+{
+    return false;
+}
+
+Ptr<OpenGymDataContainer>
+ApbAgent::GetObservation()
+{
+    std::vector<uint32_t> shape = {2};
+    Ptr<OpenGymBoxContainer<uint32_t>> box = CreateObject<OpenGymBoxContainer<uint32_t>>(shape);
+
+    box->AddValue(m_a);
+    box->AddValue(m_b);
+
+    return box;
+}
+
+float
+ApbAgent::GetReward()
+{
+    return 0.0;
+}
+
+std::string
+ApbAgent::GetExtraInfo()
+{
+    return "";
+}
+
+bool
+ApbAgent::ExecuteActions(Ptr<OpenGymDataContainer> action)
+{
+    Ptr<OpenGymBoxContainer<uint32_t>> box = DynamicCast<OpenGymBoxContainer<uint32_t>>(action);
+    m_sum = box->GetValue(0);
+    return true;
+}
+
+} // namespace ns3
+
+int
+main(int argc, char* argv[])
+{
+    using namespace ns3;
+
+    Ptr<OpenGymMultiAgentEnv> env = CreateObject<OpenGymMultiAgentEnv>();
+    env->SetOpenGymInterface(OpenGymInterface::Get());
+    std::vector<Ptr<ApbAgent>> agents;
+    for (int j = 0; j < APB_SIZE; ++j)
+    {
+        agents.push_back(CreateObject<ApbAgent>());
+        env->AddAgent("apb" + std::to_string(j), agents.back());
+    }
+
+    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> distrib(1, 10);
+
+    for (int i = 0; i < NUM_ENV; ++i)
+    {
+        std::cout << "set: ";
+        for (int j = 0; j < APB_SIZE; ++j)
+        {
+            agents[j]->m_a = distrib(gen);
+            agents[j]->m_b = distrib(gen);
+            std::cout << agents[j]->m_a << "," << agents[j]->m_b << ";";
+            env->SetAgentReady("apb" + std::to_string(j));
+        }
+        std::cout << "\n";
+
+        // one round trip for all agents
+        env->Notify();
+
+        std::cout << "get: ";
+        for (int j = 0; j < APB_SIZE; ++j)
+        {
+            std::cout << agents[j]->m_sum << ";";
+        }
+        std::cout << "\n";
+    }
+
+    env->NotifySimulationEnd();
+
+    return 0;
+}
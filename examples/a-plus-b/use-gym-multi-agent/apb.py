@@ -0,0 +1,67 @@
+# Copyright (c) 2023 Huazhong University of Science and Technology
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#
+# Author: Muyuan Shen <muyuan_shen@hust.edu.cn>
+
+
+
+from ns3ai_gym_env.envs import Ns3MultiAgentEnv
+import sys
+import traceback
+
+
+class ApbAgent:
+
+    def __init__(self):
+        pass
+
+    def get_action(self, obs):
+
+        a = obs[0]
+        b = obs[1]
+        act = a + b
+
+        return [act]
+
+env = Ns3MultiAgentEnv(targetName="ns3ai_apb_gym_multi_agent", ns3Path="../../../../../")
+print("Agents: ", env.possible_agents)
+print("Observation space: ", env.observation_space(env.possible_agents[0]))
+print("Action space: ", env.action_space(env.possible_agents[0]))
+
+try:
+    observations, infos = env.reset()
+
+    agent = ApbAgent()
+
+    # the agents are gone when the simulation ends
+    while env.agents:
+
+        actions = {name: agent.get_action(observations[name]) for name in env.agents}
+
+        observations, rewards, terminations, truncations, infos = env.step(actions)
+
+except Exception as e:
+    exc_type, exc_value, exc_traceback = sys.exc_info()
+    print("Exception occurred: {}".format(e))
+    print("Traceback:")
+    traceback.print_tb(exc_traceback)
+    exit(1)
+
+else:
+    pass
+
+finally:
+    print("Finally exiting...")
+    env.close()
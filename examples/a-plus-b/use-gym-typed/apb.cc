@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include <ns3/ai-module.h>
+#include <ns3/core-module.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#define NUM_ENV 10000
+
+namespace ns3
+{
+
+struct ApbObs
+{
+    typedef uint32_t ElementType;
+    static constexpr float low = 0;
+    static constexpr float high = 10;
+    uint32_t a;
+    uint32_t b;
+};
+
+struct ApbAct
+{
+    typedef uint32_t ElementType;
+    static constexpr float low = 0;
+    static constexpr float high = 20;
+    uint32_t sum;
+};
+
+class ApbEnv final : public OpenGymTypedEnv<ApbEnv, ApbObs, ApbAct>
+{
+  public:
+    ApbEnv();
+    ~ApbEnv() override;
+    static TypeId GetTypeId();
+
+    uint32_t GetAPlusB();
+
+    // typed OpenGym interfaces:
+    void FillObservation(ApbObs& obs);
+    void ApplyActions(const ApbAct& act);
+    bool GetGameOver() override;
+    float GetReward() override;
+    std::string GetExtraInfo() override;
+
+    uint32_t m_a;
+    uint32_t m_b;
+
+  private:
+    uint32_t m_sum;
+};
+
+ApbEnv::ApbEnv()
+{
+    SetOpenGymInterface(OpenGymInterface::Get());
+}
+
+ApbEnv::~ApbEnv()
+{
+}
+
+TypeId
+ApbEnv::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::ApbTypedEnv").SetParent<OpenGymEnv>().SetGroupName("OpenGym");
+    return tid;
+}
+
+uint32_t
+ApbEnv::GetAPlusB()
+{
+    Notify();
+    return m_sum;
+}
+
+void
+ApbEnv::FillObservation(ApbObs& obs)
+{
+    obs.a = m_a;
+    obs.b = m_b;
+}
+
+void
+ApbEnv::ApplyActions(const ApbAct& act)
+{
+    m_sum = act.sum;
+}
+
+bool
+ApbEnv::GetGameOver()
+{
+    return false;
+}
+
+float
+ApbEnv::GetReward()
+{
+    return 0.0;
+}
+
+std::string
+ApbEnv::GetExtraInfo()
+{
+    return "";
+}
+
+} // namespace ns3
+
+int
+main(int argc, char* argv[])
+{
+    using namespace ns3;
+
+    Ptr<ApbEnv> apb = CreateObject<ApbEnv>();
+
+    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> distrib(1, 10);
+
+    uint32_t sum;
+
+    for (int i = 0; i < NUM_ENV; ++i)
+    {
+        apb->m_a = distrib(gen);
+        apb->m_b = distrib(gen);
+        std::cout << "set: " << apb->m_a << "," << apb->m_b << ";";
+        std::cout << "\n";
+
+        sum = apb->GetAPlusB();
+
+        std::cout << "get: " << sum << ";";
+        std::cout << "\n";
+    }
+
+    apb->NotifySimulationEnd();
+
+    return 0;
+}
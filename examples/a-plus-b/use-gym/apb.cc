@@ -111,7 +111,9 @@ Ptr<OpenGymDataContainer>
 ApbEnv::GetObservation()
 {
     std::vector<uint32_t> shape = {2};
-    Ptr<OpenGymBoxContainer<uint32_t>> box = CreateObject<OpenGymBoxContainer<uint32_t>>(shape);
+    Ptr<OpenGymBoxContainer<uint32_t>> box =
+        m_openGymInterface->GetPooledContainer<OpenGymBoxContainer<uint32_t>>();
+    box->SetShape(shape);
 
     box->AddValue(m_a);
     box->AddValue(m_b);
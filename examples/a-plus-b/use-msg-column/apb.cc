@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include <ns3/ai-module.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#define NUM_ENV 10000
+#define APB_SIZE 3
+
+using namespace ns3;
+
+int
+main()
+{
+    auto interface = Ns3AiMsgInterface::Get();
+    interface->SetIsMemoryCreator(false);
+    interface->SetUseVector(false);
+    interface->SetHandleFinish(true);
+    Ns3AiMsgInterfaceImpl<Ns3AiEmptyMsg, Ns3AiEmptyMsg>* msgInterface =
+        interface->GetInterface<Ns3AiEmptyMsg, Ns3AiEmptyMsg>();
+
+    // Columns are also declared by Python, so shapes must match
+    uint32_t* env_a = msgInterface->AddColumn<uint32_t>("a", {APB_SIZE});
+    uint32_t* env_b = msgInterface->AddColumn<uint32_t>("b", {APB_SIZE});
+    uint32_t* act_c = msgInterface->AddColumn<uint32_t>("c", {APB_SIZE});
+
+    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> distrib(1, 10);
+
+    for (int i = 0; i < NUM_ENV; ++i)
+    {
+        msgInterface->CppSendBegin();
+        std::cout << "set: ";
+        for (int j = 0; j < APB_SIZE; ++j)
+        {
+            env_a[j] = distrib(gen);
+            env_b[j] = distrib(gen);
+            std::cout << env_a[j] << "," << env_b[j] << ";";
+        }
+        std::cout << "\n";
+        msgInterface->CppSendEnd();
+
+        msgInterface->CppRecvBegin();
+        std::cout << "get: ";
+        for (int j = 0; j < APB_SIZE; ++j)
+        {
+            std::cout << act_c[j] << ";";
+        }
+        std::cout << "\n";
+        msgInterface->CppRecvEnd();
+    }
+}
@@ -0,0 +1,63 @@
+# Copyright (c) 2023 Huazhong University of Science and Technology
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation;
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#
+# Author: Muyuan Shen <muyuan_shen@hust.edu.cn>
+
+
+import ns3ai_apb_py_column as py_binding
+from ns3ai_utils import Experiment
+import numpy as np
+import sys
+import traceback
+
+APB_SIZE = 3
+
+exp = Experiment("ns3ai_apb_msg_column", "../../../../../", py_binding,
+                 handleFinish=True)
+msgInterface = exp.msgInterface
+# columns are NumPy arrays sharing memory with C++ side
+a = msgInterface.AddColumn("a", np.uint32, [APB_SIZE])
+b = msgInterface.AddColumn("b", np.uint32, [APB_SIZE])
+c = msgInterface.AddColumn("c", np.uint32, [APB_SIZE])
+exp.run(show_output=True)
+
+try:
+    while True:
+        # receive from C++ side
+        msgInterface.PyRecvBegin()
+        if msgInterface.PyGetFinished():
+            break
+
+        # send to C++ side
+        msgInterface.PySendBegin()
+        # calculate the sums
+        np.add(a, b, out=c)
+        msgInterface.PyRecvEnd()
+        msgInterface.PySendEnd()
+
+except Exception as e:
+    exc_type, exc_value, exc_traceback = sys.exc_info()
+    print("Exception occurred: {}".format(e))
+    print("Traceback:")
+    traceback.print_tb(exc_traceback)
+    exit(1)
+
+else:
+    pass
+
+finally:
+    print("Finally exiting...")
+    del a, b, c
+    del exp
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include <ns3/ai-module.h>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+typedef ns3::Ns3AiMsgInterfaceImpl<ns3::Ns3AiEmptyMsg, ns3::Ns3AiEmptyMsg> ColumnInterface;
+
+/**
+ * NumPy array sharing memory with a column. The interface object is
+ * the array's base, so it stays alive as long as the array does.
+ */
+static py::array
+ColumnArray(py::object self, ns3::Ns3AiColumnInfo* info)
+{
+    std::vector<py::ssize_t> shape(info->m_shape, info->m_shape + info->m_rank);
+    return py::array(py::dtype(std::string(1, info->m_format)), shape, info->m_data.get(), self);
+}
+
+PYBIND11_MODULE(ns3ai_apb_py_column, m)
+{
+    py::class_<ColumnInterface>(m, "Ns3AiMsgInterfaceImpl")
+        .def(py::init<bool,
+                      bool,
+                      bool,
+                      uint32_t,
+                      const char*,
+                      const char*,
+                      const char*,
+                      const char*,
+                      uint32_t,
+                      uint32_t,
+                      uint32_t>())
+        .def("PyRecvBegin", &ColumnInterface::PyRecvBegin)
+        .def("PyRecvEnd", &ColumnInterface::PyRecvEnd)
+        .def("PySendBegin", &ColumnInterface::PySendBegin)
+        .def("PySendEnd", &ColumnInterface::PySendEnd)
+        .def("GetAttachCount", &ColumnInterface::GetAttachCount)
+        .def("EnableStats", &ColumnInterface::EnableStats, py::arg("dumpAtExit") = false)
+        .def("DumpStats", [](ColumnInterface& self) { self.DumpStats(); })
+        .def("GetLatencyPercentile", &ColumnInterface::GetLatencyPercentile)
+        .def("PyGetFinished", &ColumnInterface::PyGetFinished)
+        .def("AddColumn",
+             [](py::object self,
+                const std::string& name,
+                py::object dtype,
+                const std::vector<uint32_t>& shape) {
+                 py::dtype dt = py::dtype::from_args(dtype);
+                 char format = ns3::Ns3AiColumnFormatOf(dt.kind(), dt.itemsize());
+                 if (!format)
+                 {
+                     throw py::type_error("Unsupported dtype for column " + name);
+                 }
+                 ns3::Ns3AiColumnInfo* info =
+                     self.cast<ColumnInterface&>().AddColumn(name, format, dt.itemsize(), shape);
+                 return ColumnArray(self, info);
+             })
+        .def("GetColumn", [](py::object self, const std::string& name) -> py::object {
+            ns3::Ns3AiColumnInfo* info = self.cast<ColumnInterface&>().GetColumnInfo(name);
+            if (!info)
+            {
+                return py::none();
+            }
+            return ColumnArray(self, info);
+        });
+}
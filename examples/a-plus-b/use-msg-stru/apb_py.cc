@@ -22,18 +22,41 @@
 #include <ns3/ai-module.h>
 
 #include <iostream>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 
 namespace py = pybind11;
 
 PYBIND11_MODULE(ns3ai_apb_py_stru, m)
 {
-    py::class_<EnvStruct>(m, "PyEnvStruct")
+    // field names follow the Python attribute names
+    PYBIND11_NUMPY_DTYPE_EX(EnvStruct, env_a, "a", env_b, "b");
+    PYBIND11_NUMPY_DTYPE_EX(ActStruct, act_c, "c");
+
+    py::class_<EnvStruct>(m, "PyEnvStruct", py::buffer_protocol())
         .def(py::init<>())
+        .def_buffer([](EnvStruct& env) -> py::buffer_info {
+            return py::buffer_info(&env,
+                                   sizeof(EnvStruct),
+                                   py::format_descriptor<EnvStruct>::format(),
+                                   0,
+                                   {},
+                                   {});
+        })
         .def_readwrite("a", &EnvStruct::env_a)
         .def_readwrite("b", &EnvStruct::env_b);
 
-    py::class_<ActStruct>(m, "PyActStruct").def(py::init<>()).def_readwrite("c", &ActStruct::act_c);
+    py::class_<ActStruct>(m, "PyActStruct", py::buffer_protocol())
+        .def(py::init<>())
+        .def_buffer([](ActStruct& act) -> py::buffer_info {
+            return py::buffer_info(&act,
+                                   sizeof(ActStruct),
+                                   py::format_descriptor<ActStruct>::format(),
+                                   0,
+                                   {},
+                                   {});
+        })
+        .def_readwrite("c", &ActStruct::act_c);
 
     py::class_<ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>>(m, "Ns3AiMsgInterfaceImpl")
         .def(py::init<bool,
@@ -43,16 +66,34 @@ PYBIND11_MODULE(ns3ai_apb_py_stru, m)
                       const char*,
                       const char*,
                       const char*,
-                      const char*>())
+                      const char*,
+                      uint32_t,
+                      uint32_t,
+                      uint32_t>())
         .def("PyRecvBegin", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyRecvBegin)
         .def("PyRecvEnd", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyRecvEnd)
         .def("PySendBegin", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PySendBegin)
         .def("PySendEnd", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PySendEnd)
+        .def("GetAttachCount", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetAttachCount)
+        .def("EnableStats",
+             &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::EnableStats,
+             py::arg("dumpAtExit") = false)
+        .def("DumpStats",
+             [](ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>& self) { self.DumpStats(); })
+        .def("GetLatencyPercentile",
+             &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetLatencyPercentile)
         .def("PyGetFinished", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyGetFinished)
         .def("GetCpp2PyStruct",
              &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetCpp2PyStruct,
              py::return_value_policy::reference)
         .def("GetPy2CppStruct",
              &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetPy2CppStruct,
-             py::return_value_policy::reference);
+             py::return_value_policy::reference)
+        .def("PyRecvBeginBatch",
+             &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyRecvBeginBatch)
+        .def("PyRecvEndBatch", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyRecvEndBatch)
+        .def("GetCpp2PyStructAt",
+             &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetCpp2PyStructAt,
+             py::return_value_policy::reference)
+        .def("GetRingDepth", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetRingDepth);
 }
@@ -18,6 +18,7 @@
 
 import ns3ai_apb_py_vec as py_binding
 from ns3ai_utils import Experiment
+import numpy as np
 import sys
 import traceback
 
@@ -26,6 +27,9 @@ APB_SIZE = 3
 exp = Experiment("ns3ai_apb_msg_vec", "../../../../../", py_binding,
                  handleFinish=True, useVector=True, vectorSize=APB_SIZE)
 msgInterface = exp.run(show_output=True)
+# structured NumPy views over the shared vectors
+envs = np.asarray(msgInterface.GetCpp2PyVector())
+acts = np.asarray(msgInterface.GetPy2CppVector())
 
 try:
     while True:
@@ -36,9 +40,8 @@ try:
 
         # send to C++ side
         msgInterface.PySendBegin()
-        for i in range(len(msgInterface.GetCpp2PyVector())):
-            # calculate the sums
-            msgInterface.GetPy2CppVector()[i].c = msgInterface.GetCpp2PyVector()[i].a + msgInterface.GetCpp2PyVector()[i].b
+        # calculate the sums
+        acts['c'] = envs['a'] + envs['b']
         msgInterface.PyRecvEnd()
         msgInterface.PySendEnd()
 
@@ -22,6 +22,7 @@
 #include <ns3/ai-module.h>
 
 #include <iostream>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 
 namespace py = pybind11;
@@ -31,14 +32,48 @@ PYBIND11_MAKE_OPAQUE(ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::Py2CppMsg
 
 PYBIND11_MODULE(ns3ai_apb_py_vec, m)
 {
-    py::class_<EnvStruct>(m, "PyEnvStruct")
+    // field names follow the Python attribute names
+    PYBIND11_NUMPY_DTYPE_EX(EnvStruct, env_a, "a", env_b, "b");
+    PYBIND11_NUMPY_DTYPE_EX(ActStruct, act_c, "c");
+
+    py::class_<EnvStruct>(m, "PyEnvStruct", py::buffer_protocol())
         .def(py::init<>())
+        .def_buffer([](EnvStruct& env) -> py::buffer_info {
+            return py::buffer_info(&env,
+                                   sizeof(EnvStruct),
+                                   py::format_descriptor<EnvStruct>::format(),
+                                   0,
+                                   {},
+                                   {});
+        })
         .def_readwrite("a", &EnvStruct::env_a)
         .def_readwrite("b", &EnvStruct::env_b);
 
-    py::class_<ActStruct>(m, "PyActStruct").def(py::init<>()).def_readwrite("c", &ActStruct::act_c);
+    py::class_<ActStruct>(m, "PyActStruct", py::buffer_protocol())
+        .def(py::init<>())
+        .def_buffer([](ActStruct& act) -> py::buffer_info {
+            return py::buffer_info(&act,
+                                   sizeof(ActStruct),
+                                   py::format_descriptor<ActStruct>::format(),
+                                   0,
+                                   {},
+                                   {});
+        })
+        .def_readwrite("c", &ActStruct::act_c);
 
-    py::class_<ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::Cpp2PyMsgVector>(m, "PyEnvVector")
+    py::class_<ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::Cpp2PyMsgVector>(
+        m,
+        "PyEnvVector",
+        py::buffer_protocol())
+        .def_buffer([](ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::Cpp2PyMsgVector& vec)
+                        -> py::buffer_info {
+            return py::buffer_info(vec.data(),
+                                   sizeof(EnvStruct),
+                                   py::format_descriptor<EnvStruct>::format(),
+                                   1,
+                                   {vec.size()},
+                                   {sizeof(EnvStruct)});
+        })
         .def(
             "resize",
             static_cast<void (ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::Cpp2PyMsgVector::*)(
@@ -59,7 +94,19 @@ PYBIND11_MODULE(ns3ai_apb_py_vec, m)
             },
             py::return_value_policy::reference);
 
-    py::class_<ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::Py2CppMsgVector>(m, "PyActVector")
+    py::class_<ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::Py2CppMsgVector>(
+        m,
+        "PyActVector",
+        py::buffer_protocol())
+        .def_buffer([](ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::Py2CppMsgVector& vec)
+                        -> py::buffer_info {
+            return py::buffer_info(vec.data(),
+                                   sizeof(ActStruct),
+                                   py::format_descriptor<ActStruct>::format(),
+                                   1,
+                                   {vec.size()},
+                                   {sizeof(ActStruct)});
+        })
         .def(
             "resize",
             static_cast<void (ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::Py2CppMsgVector::*)(
@@ -88,11 +135,22 @@ PYBIND11_MODULE(ns3ai_apb_py_vec, m)
                       const char*,
                       const char*,
                       const char*,
-                      const char*>())
+                      const char*,
+                      uint32_t,
+                      uint32_t,
+                      uint32_t>())
         .def("PyRecvBegin", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyRecvBegin)
         .def("PyRecvEnd", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyRecvEnd)
         .def("PySendBegin", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PySendBegin)
         .def("PySendEnd", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PySendEnd)
+        .def("GetAttachCount", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetAttachCount)
+        .def("EnableStats",
+             &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::EnableStats,
+             py::arg("dumpAtExit") = false)
+        .def("DumpStats",
+             [](ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>& self) { self.DumpStats(); })
+        .def("GetLatencyPercentile",
+             &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetLatencyPercentile)
         .def("PyGetFinished", &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::PyGetFinished)
         .def("GetCpp2PyVector",
              &ns3::Ns3AiMsgInterfaceImpl<EnvStruct, ActStruct>::GetCpp2PyVector,
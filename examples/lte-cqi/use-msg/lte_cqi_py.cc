@@ -45,7 +45,10 @@ PYBIND11_MODULE(ns3ai_ltecqi_py, m)
                       const char*,
                       const char*,
                       const char*,
-                      const char*>())
+                      const char*,
+                      uint32_t,
+                      uint32_t,
+                      uint32_t>())
         .def("PyRecvBegin",
              &ns3::Ns3AiMsgInterfaceImpl<ns3::CqiFeature, ns3::CqiPredicted>::PyRecvBegin)
         .def("PyRecvEnd",
@@ -0,0 +1,438 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+// Round-trip benchmark of the message interface. The process creates the
+// shared memory as Python side does, then forks a peer that serves requests
+// through the Py* methods, so no Python is involved. Results are printed as JSON.
+
+#include <ns3/ai-module.h>
+#include <ns3/core-module.h>
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#define BENCH_SEGMENT_NAME "ns3ai benchmark"
+#define BENCH_CPP2PY_NAME "ns3ai benchmark cpp2py"
+#define BENCH_PY2CPP_NAME "ns3ai benchmark py2cpp"
+#define BENCH_LOCKABLE_NAME "ns3ai benchmark lockable"
+// room in the segment besides the payloads
+#define BENCH_SEGMENT_OVERHEAD 65536
+// cap on bytes moved per case, so that large payloads finish quickly
+#define BENCH_MAX_BYTES_PER_CASE (1ull << 30)
+
+using namespace ns3;
+
+/**
+ * Fixed-size payload for struct-based interface
+ */
+template <std::size_t N>
+struct BenchPayload
+{
+    uint8_t m_data[N];
+};
+
+/**
+ * Element of vector-based interface
+ */
+struct BenchElement
+{
+    double m_a;
+    double m_b;
+};
+
+struct BenchConfig
+{
+    uint32_t iterations;
+    uint32_t warmup;
+    uint32_t waitPolicy;
+    uint32_t spinCount;
+};
+
+struct BenchResult
+{
+    std::string mode;
+    uint64_t payloadBytes; //!< bytes moved in each direction per round trip
+    uint32_t vectorLength;
+    uint32_t roundTrips;
+    double seconds;
+    Ns3AiLatencyHistogram latency;
+};
+
+static uint64_t
+NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * Runs round trips between this process (C++ side) and a forked peer
+ * (Python side). setup runs on the creator before forking, cppWrite and
+ * cppRead on C++ side, and pyServe on Python side between receiving a
+ * request and sending the reply.
+ */
+template <typename Cpp2PyMsgType,
+          typename Py2CppMsgType,
+          typename Setup,
+          typename CppWrite,
+          typename CppRead,
+          typename PyServe>
+static void
+RunRoundTrips(const BenchConfig& config,
+              bool useVector,
+              uint64_t segmentSize,
+              BenchResult& result,
+              Setup setup,
+              CppWrite cppWrite,
+              CppRead cppRead,
+              PyServe pyServe)
+{
+    typedef Ns3AiMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType> Impl;
+    uint64_t bytes = result.payloadBytes ? result.payloadBytes : 1;
+    uint64_t iterations = BENCH_MAX_BYTES_PER_CASE / bytes;
+    iterations = std::max<uint64_t>(10, std::min<uint64_t>(config.iterations, iterations));
+
+    Impl py(true,
+            useVector,
+            true,
+            segmentSize,
+            BENCH_SEGMENT_NAME,
+            BENCH_CPP2PY_NAME,
+            BENCH_PY2CPP_NAME,
+            BENCH_LOCKABLE_NAME,
+            config.waitPolicy,
+            config.spinCount);
+    setup(py);
+
+    pid_t pid = fork();
+    NS_ABORT_MSG_IF(pid < 0, "fork failed");
+    if (pid == 0)
+    {
+        while (true)
+        {
+            py.PyRecvBegin();
+            if (py.PyGetFinished())
+            {
+                break;
+            }
+            py.PySendBegin();
+            pyServe(py);
+            py.PyRecvEnd();
+            py.PySendEnd();
+        }
+        // the parent owns the segment
+        _exit(0);
+    }
+
+    std::memset(&result.latency, 0, sizeof(result.latency));
+    {
+        Impl cpp(false,
+                 useVector,
+                 true,
+                 segmentSize,
+                 BENCH_SEGMENT_NAME,
+                 BENCH_CPP2PY_NAME,
+                 BENCH_PY2CPP_NAME,
+                 BENCH_LOCKABLE_NAME,
+                 config.waitPolicy,
+                 config.spinCount);
+        uint64_t start = 0;
+        for (uint64_t i = 0; i < config.warmup + iterations; ++i)
+        {
+            if (i == config.warmup)
+            {
+                start = NowNs();
+            }
+            uint64_t begin = NowNs();
+            cpp.CppSendBegin();
+            cppWrite(cpp);
+            cpp.CppSendEnd();
+            cpp.CppRecvBegin();
+            cppRead(cpp);
+            cpp.CppRecvEnd();
+            if (i >= config.warmup)
+            {
+                result.latency.Record(NowNs() - begin);
+            }
+        }
+        result.seconds = (NowNs() - start) / 1e9;
+        result.roundTrips = iterations;
+        // destroying the interface sends the finish message to the peer
+    }
+    waitpid(pid, nullptr, 0);
+}
+
+template <std::size_t N>
+static BenchResult
+BenchStruct(const BenchConfig& config)
+{
+    typedef BenchPayload<N> Payload;
+    BenchResult result;
+    result.mode = "struct";
+    result.payloadBytes = N;
+    result.vectorLength = 0;
+    std::vector<uint8_t> src(N, 0x5a);
+    std::vector<uint8_t> dst(N);
+    RunRoundTrips<Payload, Payload>(
+        config,
+        false,
+        2 * sizeof(Payload) + BENCH_SEGMENT_OVERHEAD,
+        result,
+        [](Ns3AiMsgInterfaceImpl<Payload, Payload>&) {},
+        [&](Ns3AiMsgInterfaceImpl<Payload, Payload>& cpp) {
+            std::memcpy(cpp.GetCpp2PyStruct()->m_data, src.data(), N);
+        },
+        [&](Ns3AiMsgInterfaceImpl<Payload, Payload>& cpp) {
+            std::memcpy(dst.data(), cpp.GetPy2CppStruct()->m_data, N);
+        },
+        [](Ns3AiMsgInterfaceImpl<Payload, Payload>& py) {
+            // echo the request
+            std::memcpy(py.GetPy2CppStruct()->m_data, py.GetCpp2PyStruct()->m_data, N);
+        });
+    return result;
+}
+
+static BenchResult
+BenchVector(const BenchConfig& config, uint32_t length)
+{
+    typedef Ns3AiMsgInterfaceImpl<BenchElement, BenchElement> Impl;
+    BenchResult result;
+    result.mode = "vector";
+    result.payloadBytes = length * sizeof(BenchElement);
+    result.vectorLength = length;
+    double sum = 0;
+    RunRoundTrips<BenchElement, BenchElement>(
+        config,
+        true,
+        2 * result.payloadBytes + BENCH_SEGMENT_OVERHEAD,
+        result,
+        [length](Impl& py) {
+            // the creator sizes the vectors, as Experiment does
+            py.GetCpp2PyVector()->resize(length);
+            py.GetPy2CppVector()->resize(length);
+        },
+        [length](Impl& cpp) {
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                BenchElement& element = cpp.GetCpp2PyVector()->at(i);
+                element.m_a = i;
+                element.m_b = 2 * i;
+            }
+        },
+        [length, &sum](Impl& cpp) {
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                sum += cpp.GetPy2CppVector()->at(i).m_a;
+            }
+        },
+        [length](Impl& py) {
+            for (uint32_t i = 0; i < length; ++i)
+            {
+                const BenchElement& request = py.GetCpp2PyVector()->at(i);
+                BenchElement& reply = py.GetPy2CppVector()->at(i);
+                reply.m_a = request.m_a + request.m_b;
+                reply.m_b = 0;
+            }
+        });
+    return result;
+}
+
+/**
+ * Gym path: C++ side serializes an observation box from an
+ * OpenGymBoxContainer, the peer parses it and replies with an action
+ * box of the same size, which C++ side turns back into a container.
+ * C++ side reuses its messages and action container like
+ * OpenGymInterface::NotifyCurrentState, and its observation container
+ * like a pooled one.
+ */
+static BenchResult
+BenchGym(const BenchConfig& config, uint32_t boxSize)
+{
+    typedef Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg> Impl;
+    BenchResult result;
+    result.mode = "gym";
+    result.payloadBytes = boxSize * sizeof(float);
+    result.vectorLength = boxSize;
+    std::vector<uint32_t> shape = {boxSize};
+    // reused across round trips, as OpenGymInterface does
+    ns3_ai_gym::EnvStateMsg envStateMsg;
+    ns3_ai_gym::EnvActMsg envActMsg;
+    Ptr<OpenGymDataContainer> action;
+    // reused across round trips, as OpenGymInterface::GetPooledContainer does
+    Ptr<OpenGymBoxContainer<float>> box = CreateObject<OpenGymBoxContainer<float>>(shape);
+    RunRoundTrips<Ns3AiGymMsg, Ns3AiGymMsg>(
+        config,
+        false,
+        2 * (result.payloadBytes + 1024) + BENCH_SEGMENT_OVERHEAD,
+        result,
+        [](Impl& py) {
+            // the creator allocates the message buffers, as Ns3Env does
+            Ns3AiGymAllocateBuffers(py);
+        },
+        [&box, &envStateMsg, boxSize](Impl& cpp) {
+            OpenGymSpan<float> data = box->ResizeData(boxSize);
+            for (uint32_t i = 0; i < boxSize; ++i)
+            {
+                data[i] = i;
+            }
+            box->FillDataContainerPbMsg(*envStateMsg.mutable_obsdata());
+            envStateMsg.set_reward(1);
+            Ns3AiGymMsg* msg = cpp.GetCpp2PyStruct();
+            msg->size = envStateMsg.ByteSizeLong();
+            NS_ABORT_MSG_IF(msg->size > msg->capacity, "Observation too large");
+            envStateMsg.SerializeWithCachedSizesToArray(msg->buffer.get());
+        },
+        [&envActMsg, &action](Impl& cpp) {
+            envActMsg.mutable_actdata()->mutable_data()->Clear();
+            google::protobuf::io::CodedInputStream input(cpp.GetPy2CppStruct()->buffer.get(),
+                                                         cpp.GetPy2CppStruct()->size);
+            envActMsg.MergeFromCodedStream(&input);
+            if (!action || !action->SetFromDataContainerPbMsg(envActMsg.actdata()))
+            {
+                action = OpenGymDataContainer::CreateFromDataContainerPbMsg(envActMsg.actdata());
+            }
+        },
+        [](Impl& py) {
+            ns3_ai_gym::EnvStateMsg envStateMsg;
+            envStateMsg.ParseFromArray(py.GetCpp2PyStruct()->buffer.get(),
+                                      py.GetCpp2PyStruct()->size);
+            ns3_ai_gym::BoxDataContainer obsBox;
+            envStateMsg.obsdata().data().UnpackTo(&obsBox);
+
+            ns3_ai_gym::BoxDataContainer actBox;
+            actBox.set_dtype(ns3_ai_gym::FLOAT);
+            actBox.mutable_shape()->CopyFrom(obsBox.shape());
+            actBox.mutable_floatdata()->CopyFrom(obsBox.floatdata());
+            ns3_ai_gym::EnvActMsg envActMsg;
+            envActMsg.mutable_actdata()->set_type(ns3_ai_gym::Box);
+            envActMsg.mutable_actdata()->mutable_data()->PackFrom(actBox);
+            Ns3AiGymMsg* msg = py.GetPy2CppStruct();
+            msg->size = envActMsg.ByteSizeLong();
+            NS_ABORT_MSG_IF(msg->size > msg->capacity, "Action too large");
+            envActMsg.SerializeWithCachedSizesToArray(msg->buffer.get());
+        });
+    return result;
+}
+
+static void
+WriteJson(std::ostream& os, const BenchConfig& config, const std::vector<BenchResult>& results)
+{
+    os << "{\n";
+    os << "  \"waitPolicy\": \"" << (config.waitPolicy == NS3AI_WAIT_HYBRID ? "hybrid" : "spin")
+       << "\",\n";
+    os << "  \"spinCount\": " << config.spinCount << ",\n";
+    os << "  \"warmup\": " << config.warmup << ",\n";
+    os << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& r = results[i];
+        const Ns3AiLatencyHistogram& h = r.latency;
+        os << (i ? ",\n" : "\n");
+        os << "    {\"mode\": \"" << r.mode << "\", \"payloadBytes\": " << r.payloadBytes
+           << ", \"vectorLength\": " << r.vectorLength << ", \"roundTrips\": " << r.roundTrips
+           << ", \"roundTripsPerSec\": " << r.roundTrips / r.seconds
+           << ", \"throughputMBps\": " << 2 * r.payloadBytes * r.roundTrips / r.seconds / 1e6
+           << ", \"latencyUs\": {\"min\": " << h.m_min / 1e3 << ", \"mean\": " << h.GetMean() / 1e3
+           << ", \"p50\": " << h.GetPercentile(50) / 1e3
+           << ", \"p90\": " << h.GetPercentile(90) / 1e3
+           << ", \"p99\": " << h.GetPercentile(99) / 1e3
+           << ", \"p99.9\": " << h.GetPercentile(99.9) / 1e3 << ", \"max\": " << h.m_max / 1e3
+           << "}}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+int
+main(int argc, char* argv[])
+{
+    BenchConfig config;
+    config.iterations = 10000;
+    config.warmup = 100;
+    config.spinCount = NS3AI_DEFAULT_SPIN_COUNT;
+    std::string waitPolicy = "spin";
+    std::string modes = "struct,vector,gym";
+    std::string output;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("iterations",
+                 "Round trips per case (fewer for large payloads)",
+                 config.iterations);
+    cmd.AddValue("warmup", "Round trips before measuring", config.warmup);
+    cmd.AddValue("waitPolicy", "spin or hybrid", waitPolicy);
+    cmd.AddValue("spinCount", "Probes before blocking, for hybrid policy", config.spinCount);
+    cmd.AddValue("modes", "Comma separated list of struct, vector and gym", modes);
+    cmd.AddValue("output", "JSON output file, stdout if empty", output);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(waitPolicy != "spin" && waitPolicy != "hybrid",
+                    "Unknown wait policy " << waitPolicy);
+    config.waitPolicy = waitPolicy == "hybrid" ? NS3AI_WAIT_HYBRID : NS3AI_WAIT_SPIN;
+    auto enabled = [&modes](const std::string& mode) {
+        return ("," + modes + ",").find("," + mode + ",") != std::string::npos;
+    };
+
+    std::vector<BenchResult> results;
+    if (enabled("struct"))
+    {
+        results.push_back(BenchStruct<8>(config));
+        results.push_back(BenchStruct<64>(config));
+        results.push_back(BenchStruct<512>(config));
+        results.push_back(BenchStruct<4096>(config));
+        results.push_back(BenchStruct<32768>(config));
+        results.push_back(BenchStruct<262144>(config));
+        results.push_back(BenchStruct<2097152>(config));
+        results.push_back(BenchStruct<8388608>(config));
+    }
+    if (enabled("vector"))
+    {
+        for (uint32_t length : {1, 10, 100, 1000, 10000})
+        {
+            results.push_back(BenchVector(config, length));
+        }
+    }
+    if (enabled("gym"))
+    {
+        for (uint32_t boxSize : {1, 10, 100, 1000, 10000, 100000, 1000000})
+        {
+            results.push_back(BenchGym(config, boxSize));
+        }
+    }
+
+    if (output.empty())
+    {
+        WriteJson(std::cout, config, results);
+    }
+    else
+    {
+        std::ofstream ofs(output);
+        NS_ABORT_MSG_IF(!ofs, "Cannot open " << output);
+        WriteJson(ofs, config, results);
+    }
+    return 0;
+}
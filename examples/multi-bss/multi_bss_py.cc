@@ -22,6 +22,7 @@
 #include <ns3/ai-module.h>
 
 #include <iostream>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl_bind.h>
 
@@ -32,6 +33,10 @@ PYBIND11_MAKE_OPAQUE(ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Py2CppMsgVector);
 
 PYBIND11_MODULE(ns3ai_multibss_py, m)
 {
+    // field layout of the structured arrays, taken from the C++ structs
+    PYBIND11_NUMPY_DTYPE(Env, txNode, rxPower, mcs, holDelay, throughput);
+    PYBIND11_NUMPY_DTYPE(Act, newCcaSensitivity);
+
     py::class_<std::array<double, 5>>(m, "RxPowerArray")
         .def(py::init<>())
         .def("size", &std::array<double, 5>::size)
@@ -46,19 +51,46 @@ PYBIND11_MODULE(ns3ai_multibss_py, m)
             return arr.at(i);
         });
 
-    py::class_<Env>(m, "PyEnvStruct")
+    py::class_<Env>(m, "PyEnvStruct", py::buffer_protocol())
         .def(py::init<>())
+        .def_buffer([](Env& env) -> py::buffer_info {
+            return py::buffer_info(&env,
+                                   sizeof(Env),
+                                   py::format_descriptor<Env>::format(),
+                                   0,
+                                   {},
+                                   {});
+        })
         .def_readwrite("txNode", &Env::txNode)
         .def_readwrite("rxPower", &Env::rxPower)
         .def_readwrite("mcs", &Env::mcs)
         .def_readwrite("holDelay", &Env::holDelay)
         .def_readwrite("throughput", &Env::throughput);
 
-    py::class_<Act>(m, "PyActStruct")
+    py::class_<Act>(m, "PyActStruct", py::buffer_protocol())
         .def(py::init<>())
+        .def_buffer([](Act& act) -> py::buffer_info {
+            return py::buffer_info(&act,
+                                   sizeof(Act),
+                                   py::format_descriptor<Act>::format(),
+                                   0,
+                                   {},
+                                   {});
+        })
         .def_readwrite("newCcaSensitivity", &Act::newCcaSensitivity);
 
-    py::class_<ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Cpp2PyMsgVector>(m, "PyEnvVector")
+    py::class_<ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Cpp2PyMsgVector>(m,
+                                                                  "PyEnvVector",
+                                                                  py::buffer_protocol())
+        .def_buffer(
+            [](ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Cpp2PyMsgVector& vec) -> py::buffer_info {
+                return py::buffer_info(vec.data(),
+                                       sizeof(Env),
+                                       py::format_descriptor<Env>::format(),
+                                       1,
+                                       {vec.size()},
+                                       {sizeof(Env)});
+            })
         .def("resize",
              static_cast<void (ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Cpp2PyMsgVector::*)(
                  ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Cpp2PyMsgVector::size_type)>(
@@ -77,7 +109,18 @@ PYBIND11_MODULE(ns3ai_multibss_py, m)
             },
             py::return_value_policy::reference);
 
-    py::class_<ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Py2CppMsgVector>(m, "PyActVector")
+    py::class_<ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Py2CppMsgVector>(m,
+                                                                  "PyActVector",
+                                                                  py::buffer_protocol())
+        .def_buffer(
+            [](ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Py2CppMsgVector& vec) -> py::buffer_info {
+                return py::buffer_info(vec.data(),
+                                       sizeof(Act),
+                                       py::format_descriptor<Act>::format(),
+                                       1,
+                                       {vec.size()},
+                                       {sizeof(Act)});
+            })
         .def("resize",
              static_cast<void (ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Py2CppMsgVector::*)(
                  ns3::Ns3AiMsgInterfaceImpl<Env, Act>::Py2CppMsgVector::size_type)>(
@@ -104,11 +147,20 @@ PYBIND11_MODULE(ns3ai_multibss_py, m)
                       const char*,
                       const char*,
                       const char*,
-                      const char*>())
+                      const char*,
+                      uint32_t,
+                      uint32_t,
+                      uint32_t>())
         .def("PyRecvBegin", &ns3::Ns3AiMsgInterfaceImpl<Env, Act>::PyRecvBegin)
         .def("PyRecvEnd", &ns3::Ns3AiMsgInterfaceImpl<Env, Act>::PyRecvEnd)
         .def("PySendBegin", &ns3::Ns3AiMsgInterfaceImpl<Env, Act>::PySendBegin)
         .def("PySendEnd", &ns3::Ns3AiMsgInterfaceImpl<Env, Act>::PySendEnd)
+        .def("GetAttachCount", &ns3::Ns3AiMsgInterfaceImpl<Env, Act>::GetAttachCount)
+        .def("EnableStats",
+             &ns3::Ns3AiMsgInterfaceImpl<Env, Act>::EnableStats,
+             py::arg("dumpAtExit") = false)
+        .def("DumpStats", [](ns3::Ns3AiMsgInterfaceImpl<Env, Act>& self) { self.DumpStats(); })
+        .def("GetLatencyPercentile", &ns3::Ns3AiMsgInterfaceImpl<Env, Act>::GetLatencyPercentile)
         .def("PyGetFinished", &ns3::Ns3AiMsgInterfaceImpl<Env, Act>::PyGetFinished)
         .def("GetCpp2PyVector",
              &ns3::Ns3AiMsgInterfaceImpl<Env, Act>::GetCpp2PyVector,
@@ -49,7 +49,10 @@ PYBIND11_MODULE(ns3ai_ratecontrol_constant_py, m)
                       const char*,
                       const char*,
                       const char*,
-                      const char*>())
+                      const char*,
+                      uint32_t,
+                      uint32_t,
+                      uint32_t>())
         .def("PyRecvBegin",
              &ns3::Ns3AiMsgInterfaceImpl<ns3::AiConstantRateEnvStruct,
                                          ns3::AiConstantRateActStruct>::PyRecvBegin)
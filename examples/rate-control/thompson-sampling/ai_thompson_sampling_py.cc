@@ -96,7 +96,10 @@ PYBIND11_MODULE(ns3ai_ratecontrol_ts_py, m)
                       const char*,
                       const char*,
                       const char*,
-                      const char*>())
+                      const char*,
+                      uint32_t,
+                      uint32_t,
+                      uint32_t>())
         .def("PyRecvBegin",
              &ns3::Ns3AiMsgInterfaceImpl<ns3::AiThompsonSamplingEnvStruct,
                                          ns3::AiThompsonSamplingActStruct>::PyRecvBegin)
@@ -98,6 +98,8 @@ class TcpNewRenoAgent:
         pass
 
     def get_action(self, obs, reward, done, info):
+        # observations are uint64 arrays, converted so that differences can be negative
+        obs = np.asarray(obs, dtype=np.int64)
         # current ssThreshold
         ssThresh = obs[4]
         # current contention window size
@@ -137,6 +139,8 @@ class TcpDeepQAgent:
         self.s_ = None  # next state
 
     def get_action(self, obs, reward, done, info):
+        # observations are uint64 arrays, converted so that differences can be negative
+        obs = np.asarray(obs, dtype=np.int64)
         # current ssThreshold
         ssThresh = obs[4]
         # current contention window size
@@ -199,6 +203,8 @@ class TcpQAgent:
         self.s_ = None  # next state
 
     def get_action(self, obs, reward, done, info):
+        # observations are uint64 arrays, converted so that differences can be negative
+        obs = np.asarray(obs, dtype=np.int64)
         # current ssThreshold
         # ssThresh = obs[4]
         # current contention window size
@@ -298,7 +298,9 @@ TcpTimeStepEnv::GetObservation()
         parameterNum,
     };
 
-    Ptr<OpenGymBoxContainer<uint64_t>> box = CreateObject<OpenGymBoxContainer<uint64_t>>(shape);
+    Ptr<OpenGymBoxContainer<uint64_t>> box =
+        m_openGymInterface->GetPooledContainer<OpenGymBoxContainer<uint64_t>>();
+    box->SetShape(shape);
 
     box->AddValue(m_socketUuid);
     box->AddValue(1);
@@ -570,7 +572,9 @@ TcpEventBasedEnv::GetObservation()
         parameterNum,
     };
 
-    Ptr<OpenGymBoxContainer<uint64_t>> box = CreateObject<OpenGymBoxContainer<uint64_t>>(shape);
+    Ptr<OpenGymBoxContainer<uint64_t>> box =
+        m_openGymInterface->GetPooledContainer<OpenGymBoxContainer<uint64_t>>();
+    box->SetShape(shape);
 
     box->AddValue(m_socketUuid);
     box->AddValue(0);
@@ -21,6 +21,7 @@
 
 #include "container.h"
 
+#include <ns3/abort.h>
 #include <ns3/log.h>
 
 namespace ns3
@@ -60,8 +61,281 @@ OpenGymDataContainer::DoInitialize()
     // NS_LOG_FUNCTION (this);
 }
 
+/**
+ * Resizes the elements of a reused tuple or dict message. Removed
+ * elements are kept by protobuf and handed out again when added.
+ */
+static void
+ResizeElements(google::protobuf::RepeatedPtrField<ns3_ai_gym::DataContainer>* elements, int size)
+{
+    while (elements->size() > size)
+    {
+        elements->RemoveLast();
+    }
+    while (elements->size() < size)
+    {
+        elements->Add();
+    }
+}
+
+void
+OpenGymDataContainer::FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer)
+{
+    // copy field by field, since clearing the message would free its Any
+    ns3_ai_gym::DataContainer dataContainerPbMsg = GetDataContainerPbMsg();
+    dataContainer.set_type(dataContainerPbMsg.type());
+    dataContainer.set_name(dataContainerPbMsg.name());
+    dataContainer.mutable_data()->CopyFrom(dataContainerPbMsg.data());
+}
+
+void
+OpenGymDataContainer::PackData(const google::protobuf::Message& msg,
+                               ns3_ai_gym::DataContainer& dataContainer)
+{
+    static const std::string prefix = "type.googleapis.com/";
+    google::protobuf::Any* any = dataContainer.mutable_data();
+    const std::string& name = msg.GetDescriptor()->full_name();
+    const std::string& url = any->type_url();
+    if (url.size() != prefix.size() + name.size() || url.compare(0, prefix.size(), prefix) != 0 ||
+        url.compare(prefix.size(), std::string::npos, name) != 0)
+    {
+        any->PackFrom(msg);
+        return;
+    }
+    msg.SerializeToString(any->mutable_value());
+}
+
+bool
+OpenGymDataContainer::SetFromDataContainerPbMsg(const ns3_ai_gym::DataContainer& dataContainer)
+{
+    return false;
+}
+
+uint64_t
+OpenGymDataContainer::GetRawSize()
+{
+    // containers defined elsewhere are written through their protobuf message
+    Ptr<OpenGymDataContainer> container = CreateFromDataContainerPbMsg(GetDataContainerPbMsg());
+    NS_ABORT_MSG_IF(!container, "Container cannot be written as a raw node");
+    return container->GetRawSize();
+}
+
+uint64_t
+OpenGymDataContainer::WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name)
+{
+    Ptr<OpenGymDataContainer> container = CreateFromDataContainerPbMsg(GetDataContainerPbMsg());
+    NS_ABORT_MSG_IF(!container, "Container cannot be written as a raw node");
+    return container->WriteRaw(buffer, offset, name);
+}
+
+bool
+OpenGymDataContainer::SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset)
+{
+    return false;
+}
+
+void
+OpenGymDataContainer::WriteFlat(uint8_t* data,
+                                const Ns3AiGymFlatField*& field,
+                                const Ns3AiGymFlatField* end)
+{
+    Ptr<OpenGymDataContainer> container = CreateFromDataContainerPbMsg(GetDataContainerPbMsg());
+    NS_ABORT_MSG_IF(!container, "Container cannot be written in the flat format");
+    container->WriteFlat(data, field, end);
+}
+
+void
+OpenGymDataContainer::Clear()
+{
+}
+
+void
+OpenGymDataContainer::AppendValues(std::vector<double>& values) const
+{
+}
+
+void
+OpenGymDataContainer::Normalize(OpenGymNormalizer& normalizer)
+{
+}
+
+uint64_t
+OpenGymDataContainer::WriteRawName(uint8_t* buffer,
+                                   uint64_t offset,
+                                   Ns3AiGymRawNode& node,
+                                   const std::string& name)
+{
+    NS_ABORT_MSG_IF(name.size() > UINT16_MAX, "Name " << name << " is too long");
+    node.m_nameLength = name.size();
+    std::memcpy(buffer + offset + sizeof(Ns3AiGymRawNode), name.data(), name.size());
+    return offset + sizeof(Ns3AiGymRawNode) + Ns3AiGymRawAlign(name.size());
+}
+
+uint64_t
+OpenGymDataContainer::WriteRawNode(uint8_t* buffer,
+                                   uint64_t offset,
+                                   Ns3AiGymRawNode& node,
+                                   uint64_t end)
+{
+    node.m_size = end - offset;
+    std::memcpy(buffer + offset, &node, sizeof(Ns3AiGymRawNode));
+    return end;
+}
+
+const Ns3AiGymFlatField&
+OpenGymDataContainer::NextFlatField(const Ns3AiGymFlatField*& field,
+                                    const Ns3AiGymFlatField* end,
+                                    char format,
+                                    uint64_t count)
+{
+    NS_ABORT_MSG_IF(field == end, "Observation has more elements than its space");
+    NS_ABORT_MSG_IF(field->m_format != format || field->m_count != count,
+                    "Observation of " << count << " '" << format << "' elements does not match "
+                                      << field->m_count << " '" << field->m_format
+                                      << "' elements of its space");
+    return *field++;
+}
+
+/**
+ * Gets the child offsets of the Tuple or Dict node at the given offset of
+ * a message of size bytes, or nullptr if they do not fit in it. Children
+ * are written after their parent, so an offset at or before the parent's
+ * is rejected rather than followed around a loop.
+ */
+static const uint64_t*
+GetRawChildren(const uint8_t* buffer, uint64_t size, uint64_t offset)
+{
+    uint64_t payload = Ns3AiGymRawCheckedPayload(buffer, size, offset, sizeof(uint64_t));
+    if (!payload)
+    {
+        return nullptr;
+    }
+    const Ns3AiGymRawNode* node = reinterpret_cast<const Ns3AiGymRawNode*>(buffer + offset);
+    const uint64_t* children = reinterpret_cast<const uint64_t*>(buffer + payload);
+    for (uint64_t i = 0; i < node->m_count; ++i)
+    {
+        if (children[i] <= offset)
+        {
+            return nullptr;
+        }
+    }
+    return children;
+}
+
+template <typename T>
+static Ptr<OpenGymDataContainer>
+CreateBoxFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset)
+{
+    Ptr<OpenGymBoxContainer<T>> box = CreateObject<OpenGymBoxContainer<T>>();
+    if (!box->SetFromRaw(buffer, size, offset))
+    {
+        return nullptr;
+    }
+    return box;
+}
+
 Ptr<OpenGymDataContainer>
-OpenGymDataContainer::CreateFromDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainerPbMsg)
+OpenGymDataContainer::CreateFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset)
+{
+    if (!Ns3AiGymRawCheckedPayload(buffer, size, offset, 0))
+    {
+        return nullptr;
+    }
+    const Ns3AiGymRawNode* node = reinterpret_cast<const Ns3AiGymRawNode*>(buffer + offset);
+
+    if (node->m_type == ns3_ai_gym::Discrete)
+    {
+        Ptr<OpenGymDiscreteContainer> discrete = CreateObject<OpenGymDiscreteContainer>();
+        if (discrete->SetFromRaw(buffer, size, offset))
+        {
+            return discrete;
+        }
+    }
+    else if (node->m_type == ns3_ai_gym::Box)
+    {
+        switch (node->m_format)
+        {
+        case '?':
+            return CreateBoxFromRaw<bool>(buffer, size, offset);
+        case 'b':
+            return CreateBoxFromRaw<int8_t>(buffer, size, offset);
+        case 'B':
+            return CreateBoxFromRaw<uint8_t>(buffer, size, offset);
+        case 'h':
+            return CreateBoxFromRaw<int16_t>(buffer, size, offset);
+        case 'H':
+            return CreateBoxFromRaw<uint16_t>(buffer, size, offset);
+        case 'i':
+            return CreateBoxFromRaw<int32_t>(buffer, size, offset);
+        case 'I':
+            return CreateBoxFromRaw<uint32_t>(buffer, size, offset);
+        case 'q':
+            return CreateBoxFromRaw<int64_t>(buffer, size, offset);
+        case 'Q':
+            return CreateBoxFromRaw<uint64_t>(buffer, size, offset);
+        case 'f':
+            return CreateBoxFromRaw<float>(buffer, size, offset);
+        case 'd':
+            return CreateBoxFromRaw<double>(buffer, size, offset);
+        }
+    }
+    else if (node->m_type == ns3_ai_gym::Tuple)
+    {
+        const uint64_t* children = GetRawChildren(buffer, size, offset);
+        if (!children)
+        {
+            return nullptr;
+        }
+        Ptr<OpenGymTupleContainer> tupleData = CreateObject<OpenGymTupleContainer>();
+        for (uint64_t i = 0; i < node->m_count; ++i)
+        {
+            Ptr<OpenGymDataContainer> element = CreateFromRaw(buffer, size, children[i]);
+            if (!element)
+            {
+                return nullptr;
+            }
+            tupleData->Add(element);
+        }
+        return tupleData;
+    }
+    else if (node->m_type == ns3_ai_gym::Dict)
+    {
+        const uint64_t* children = GetRawChildren(buffer, size, offset);
+        if (!children)
+        {
+            return nullptr;
+        }
+        Ptr<OpenGymDictContainer> dictData = CreateObject<OpenGymDictContainer>();
+        for (uint64_t i = 0; i < node->m_count; ++i)
+        {
+            // checks the child and its name before reading the name
+            Ptr<OpenGymDataContainer> element = CreateFromRaw(buffer, size, children[i]);
+            if (!element)
+            {
+                return nullptr;
+            }
+            const Ns3AiGymRawNode* child =
+                reinterpret_cast<const Ns3AiGymRawNode*>(buffer + children[i]);
+            const char* name = reinterpret_cast<const char*>(child + 1);
+            dictData->Add(std::string(name, child->m_nameLength), element);
+        }
+        return dictData;
+    }
+    return nullptr;
+}
+
+template <typename T>
+static Ptr<OpenGymDataContainer>
+CreateBoxFromPbMsg(const ns3_ai_gym::DataContainer& dataContainerPbMsg)
+{
+    Ptr<OpenGymBoxContainer<T>> box = CreateObject<OpenGymBoxContainer<T>>();
+    box->SetFromDataContainerPbMsg(dataContainerPbMsg);
+    return box;
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymDataContainer::CreateFromDataContainerPbMsg(
+    const ns3_ai_gym::DataContainer& dataContainerPbMsg)
 {
     Ptr<OpenGymDataContainer> actDataContainer;
 
@@ -113,6 +387,34 @@ OpenGymDataContainer::CreateFromDataContainerPbMsg(ns3_ai_gym::DataContainer& da
             box->SetData(myData);
             actDataContainer = box;
         }
+        else if (boxContainerPbMsg.dtype() == ns3_ai_gym::INT8)
+        {
+            actDataContainer = CreateBoxFromPbMsg<int8_t>(dataContainerPbMsg);
+        }
+        else if (boxContainerPbMsg.dtype() == ns3_ai_gym::INT16)
+        {
+            actDataContainer = CreateBoxFromPbMsg<int16_t>(dataContainerPbMsg);
+        }
+        else if (boxContainerPbMsg.dtype() == ns3_ai_gym::INT64)
+        {
+            actDataContainer = CreateBoxFromPbMsg<int64_t>(dataContainerPbMsg);
+        }
+        else if (boxContainerPbMsg.dtype() == ns3_ai_gym::UINT8)
+        {
+            actDataContainer = CreateBoxFromPbMsg<uint8_t>(dataContainerPbMsg);
+        }
+        else if (boxContainerPbMsg.dtype() == ns3_ai_gym::UINT16)
+        {
+            actDataContainer = CreateBoxFromPbMsg<uint16_t>(dataContainerPbMsg);
+        }
+        else if (boxContainerPbMsg.dtype() == ns3_ai_gym::UINT64)
+        {
+            actDataContainer = CreateBoxFromPbMsg<uint64_t>(dataContainerPbMsg);
+        }
+        else if (boxContainerPbMsg.dtype() == ns3_ai_gym::BOOL)
+        {
+            actDataContainer = CreateBoxFromPbMsg<bool>(dataContainerPbMsg);
+        }
         else
         {
             Ptr<OpenGymBoxContainer<float>> box = CreateObject<OpenGymBoxContainer<float>>();
@@ -130,14 +432,10 @@ OpenGymDataContainer::CreateFromDataContainerPbMsg(ns3_ai_gym::DataContainer& da
         ns3_ai_gym::TupleDataContainer tupleContainerPbMsg;
         dataContainerPbMsg.data().UnpackTo(&tupleContainerPbMsg);
 
-        std::vector<ns3_ai_gym::DataContainer> elements;
-        elements.assign(tupleContainerPbMsg.element().begin(), tupleContainerPbMsg.element().end());
-
-        std::vector<ns3_ai_gym::DataContainer>::iterator it;
-        for (it = elements.begin(); it != elements.end(); ++it)
+        for (const ns3_ai_gym::DataContainer& element : tupleContainerPbMsg.element())
         {
             Ptr<OpenGymDataContainer> subData =
-                OpenGymDataContainer::CreateFromDataContainerPbMsg(*it);
+                OpenGymDataContainer::CreateFromDataContainerPbMsg(element);
             tupleData->Add(subData);
         }
 
@@ -150,15 +448,11 @@ OpenGymDataContainer::CreateFromDataContainerPbMsg(ns3_ai_gym::DataContainer& da
         ns3_ai_gym::DictDataContainer dictContainerPbMsg;
         dataContainerPbMsg.data().UnpackTo(&dictContainerPbMsg);
 
-        std::vector<ns3_ai_gym::DataContainer> elements;
-        elements.assign(dictContainerPbMsg.element().begin(), dictContainerPbMsg.element().end());
-
-        std::vector<ns3_ai_gym::DataContainer>::iterator it;
-        for (it = elements.begin(); it != elements.end(); ++it)
+        for (const ns3_ai_gym::DataContainer& element : dictContainerPbMsg.element())
         {
             Ptr<OpenGymDataContainer> subSpace =
-                OpenGymDataContainer::CreateFromDataContainerPbMsg(*it);
-            dictData->Add((*it).name(), subSpace);
+                OpenGymDataContainer::CreateFromDataContainerPbMsg(element);
+            dictData->Add(element.name(), subSpace);
         }
 
         actDataContainer = dictData;
@@ -209,14 +503,31 @@ ns3_ai_gym::DataContainer
 OpenGymDiscreteContainer::GetDataContainerPbMsg()
 {
     ns3_ai_gym::DataContainer dataContainerPbMsg;
-    ns3_ai_gym::DiscreteDataContainer discreteContainerPbMsg;
-    discreteContainerPbMsg.set_data(GetValue());
-
-    dataContainerPbMsg.set_type(ns3_ai_gym::Discrete);
-    dataContainerPbMsg.mutable_data()->PackFrom(discreteContainerPbMsg);
+    FillDataContainerPbMsg(dataContainerPbMsg);
     return dataContainerPbMsg;
 }
 
+void
+OpenGymDiscreteContainer::FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer)
+{
+    m_pbMsg.set_data(GetValue());
+
+    dataContainer.set_type(ns3_ai_gym::Discrete);
+    PackData(m_pbMsg, dataContainer);
+}
+
+bool
+OpenGymDiscreteContainer::SetFromDataContainerPbMsg(
+    const ns3_ai_gym::DataContainer& dataContainer)
+{
+    if (dataContainer.type() != ns3_ai_gym::Discrete || !dataContainer.data().UnpackTo(&m_pbMsg))
+    {
+        return false;
+    }
+    SetValue(m_pbMsg.data());
+    return true;
+}
+
 bool
 OpenGymDiscreteContainer::SetValue(uint32_t value)
 {
@@ -230,6 +541,71 @@ OpenGymDiscreteContainer::GetValue() const
     return m_value;
 }
 
+void
+OpenGymDiscreteContainer::Clear()
+{
+    m_value = 0;
+}
+
+void
+OpenGymDiscreteContainer::AppendValues(std::vector<double>& values) const
+{
+    values.push_back(m_value);
+}
+
+void
+OpenGymDiscreteContainer::Normalize(OpenGymNormalizer& normalizer)
+{
+    normalizer.Skip(1);
+}
+
+uint64_t
+OpenGymDiscreteContainer::GetRawSize()
+{
+    return sizeof(Ns3AiGymRawNode) + Ns3AiGymRawAlign(sizeof(uint32_t));
+}
+
+uint64_t
+OpenGymDiscreteContainer::WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name)
+{
+    Ns3AiGymRawNode node = {};
+    node.m_type = ns3_ai_gym::Discrete;
+    node.m_format = Ns3AiColumnFormat<uint32_t>::value;
+    node.m_itemSize = sizeof(uint32_t);
+    node.m_count = 1;
+    uint64_t payload = WriteRawName(buffer, offset, node, name);
+    std::memcpy(buffer + payload, &m_value, sizeof(uint32_t));
+    return WriteRawNode(buffer, offset, node, payload + Ns3AiGymRawAlign(sizeof(uint32_t)));
+}
+
+bool
+OpenGymDiscreteContainer::SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset)
+{
+    uint64_t payload = Ns3AiGymRawCheckedPayload(buffer, size, offset, sizeof(uint32_t));
+    if (!payload)
+    {
+        return false;
+    }
+    const Ns3AiGymRawNode* node = reinterpret_cast<const Ns3AiGymRawNode*>(buffer + offset);
+    if (node->m_type != ns3_ai_gym::Discrete ||
+        node->m_format != Ns3AiColumnFormat<uint32_t>::value || node->m_count != 1)
+    {
+        return false;
+    }
+    std::memcpy(&m_value, buffer + payload, sizeof(uint32_t));
+    return true;
+}
+
+void
+OpenGymDiscreteContainer::WriteFlat(uint8_t* data,
+                                    const Ns3AiGymFlatField*& field,
+                                    const Ns3AiGymFlatField* end)
+{
+    const Ns3AiGymFlatField& flat =
+        NextFlatField(field, end, Ns3AiColumnFormat<uint32_t>::value, 1);
+    std::memcpy(data + flat.m_offset, &m_value, sizeof(uint32_t));
+}
+
 void
 OpenGymDiscreteContainer::Print(std::ostream& where) const
 {
@@ -272,21 +648,125 @@ ns3_ai_gym::DataContainer
 OpenGymTupleContainer::GetDataContainerPbMsg()
 {
     ns3_ai_gym::DataContainer dataContainerPbMsg;
-    dataContainerPbMsg.set_type(ns3_ai_gym::Tuple);
+    FillDataContainerPbMsg(dataContainerPbMsg);
+    return dataContainerPbMsg;
+}
+
+void
+OpenGymTupleContainer::FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer)
+{
+    ResizeElements(m_pbMsg.mutable_element(), m_tuple.size());
+    for (uint32_t i = 0; i < m_tuple.size(); ++i)
+    {
+        m_tuple[i]->FillDataContainerPbMsg(*m_pbMsg.mutable_element(i));
+    }
 
-    ns3_ai_gym::TupleDataContainer tupleContainerPbMsg;
+    dataContainer.set_type(ns3_ai_gym::Tuple);
+    PackData(m_pbMsg, dataContainer);
+}
 
-    std::vector<Ptr<OpenGymDataContainer>>::iterator it;
-    for (it = m_tuple.begin(); it != m_tuple.end(); ++it)
+bool
+OpenGymTupleContainer::SetFromDataContainerPbMsg(const ns3_ai_gym::DataContainer& dataContainer)
+{
+    if (dataContainer.type() != ns3_ai_gym::Tuple || !dataContainer.data().UnpackTo(&m_pbMsg) ||
+        m_pbMsg.element_size() != static_cast<int>(m_tuple.size()))
     {
-        Ptr<OpenGymDataContainer> subSpace = *it;
-        ns3_ai_gym::DataContainer subDataContainer = subSpace->GetDataContainerPbMsg();
+        return false;
+    }
+    for (uint32_t i = 0; i < m_tuple.size(); ++i)
+    {
+        if (!m_tuple[i]->SetFromDataContainerPbMsg(m_pbMsg.element(i)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-        tupleContainerPbMsg.add_element()->CopyFrom(subDataContainer);
+uint64_t
+OpenGymTupleContainer::GetRawSize()
+{
+    uint64_t size = sizeof(Ns3AiGymRawNode) + m_tuple.size() * sizeof(uint64_t);
+    for (const Ptr<OpenGymDataContainer>& element : m_tuple)
+    {
+        size += element->GetRawSize();
     }
+    return size;
+}
 
-    dataContainerPbMsg.mutable_data()->PackFrom(tupleContainerPbMsg);
-    return dataContainerPbMsg;
+uint64_t
+OpenGymTupleContainer::WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name)
+{
+    Ns3AiGymRawNode node = {};
+    node.m_type = ns3_ai_gym::Tuple;
+    node.m_count = m_tuple.size();
+    uint64_t payload = WriteRawName(buffer, offset, node, name);
+    uint64_t* children = reinterpret_cast<uint64_t*>(buffer + payload);
+    uint64_t end = payload + m_tuple.size() * sizeof(uint64_t);
+    for (uint32_t i = 0; i < m_tuple.size(); ++i)
+    {
+        children[i] = end;
+        end = m_tuple[i]->WriteRaw(buffer, end, "");
+    }
+    return WriteRawNode(buffer, offset, node, end);
+}
+
+bool
+OpenGymTupleContainer::SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset)
+{
+    const uint64_t* children = GetRawChildren(buffer, size, offset);
+    if (!children)
+    {
+        return false;
+    }
+    const Ns3AiGymRawNode* node = reinterpret_cast<const Ns3AiGymRawNode*>(buffer + offset);
+    if (node->m_type != ns3_ai_gym::Tuple || node->m_count != m_tuple.size())
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < m_tuple.size(); ++i)
+    {
+        if (!m_tuple[i]->SetFromRaw(buffer, size, children[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+OpenGymTupleContainer::WriteFlat(uint8_t* data,
+                                 const Ns3AiGymFlatField*& field,
+                                 const Ns3AiGymFlatField* end)
+{
+    for (const Ptr<OpenGymDataContainer>& element : m_tuple)
+    {
+        element->WriteFlat(data, field, end);
+    }
+}
+
+void
+OpenGymTupleContainer::Clear()
+{
+    m_tuple.clear();
+}
+
+void
+OpenGymTupleContainer::AppendValues(std::vector<double>& values) const
+{
+    for (const Ptr<OpenGymDataContainer>& element : m_tuple)
+    {
+        element->AppendValues(values);
+    }
+}
+
+void
+OpenGymTupleContainer::Normalize(OpenGymNormalizer& normalizer)
+{
+    for (const Ptr<OpenGymDataContainer>& element : m_tuple)
+    {
+        element->Normalize(normalizer);
+    }
 }
 
 bool
@@ -368,24 +848,139 @@ ns3_ai_gym::DataContainer
 OpenGymDictContainer::GetDataContainerPbMsg()
 {
     ns3_ai_gym::DataContainer dataContainerPbMsg;
-    dataContainerPbMsg.set_type(ns3_ai_gym::Dict);
+    FillDataContainerPbMsg(dataContainerPbMsg);
+    return dataContainerPbMsg;
+}
 
-    ns3_ai_gym::DictDataContainer dictContainerPbMsg;
+void
+OpenGymDictContainer::FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer)
+{
+    ResizeElements(m_pbMsg.mutable_element(), m_dict.size());
+    int i = 0;
+    for (auto it = m_dict.begin(); it != m_dict.end(); ++it, ++i)
+    {
+        ns3_ai_gym::DataContainer* element = m_pbMsg.mutable_element(i);
+        it->second->FillDataContainerPbMsg(*element);
+        element->set_name(it->first);
+    }
+
+    dataContainer.set_type(ns3_ai_gym::Dict);
+    PackData(m_pbMsg, dataContainer);
+}
 
-    std::map<std::string, Ptr<OpenGymDataContainer>>::iterator it;
-    for (it = m_dict.begin(); it != m_dict.end(); ++it)
+bool
+OpenGymDictContainer::SetFromDataContainerPbMsg(const ns3_ai_gym::DataContainer& dataContainer)
+{
+    if (dataContainer.type() != ns3_ai_gym::Dict || !dataContainer.data().UnpackTo(&m_pbMsg) ||
+        m_pbMsg.element_size() != static_cast<int>(m_dict.size()))
     {
-        std::string name = it->first;
-        Ptr<OpenGymDataContainer> subSpace = it->second;
+        return false;
+    }
+    for (const ns3_ai_gym::DataContainer& element : m_pbMsg.element())
+    {
+        auto it = m_dict.find(element.name());
+        if (it == m_dict.end() || !it->second->SetFromDataContainerPbMsg(element))
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-        ns3_ai_gym::DataContainer subDataContainer = subSpace->GetDataContainerPbMsg();
-        subDataContainer.set_name(name);
+uint64_t
+OpenGymDictContainer::GetRawSize()
+{
+    uint64_t size = sizeof(Ns3AiGymRawNode) + m_dict.size() * sizeof(uint64_t);
+    for (const auto& element : m_dict)
+    {
+        size += Ns3AiGymRawAlign(element.first.size()) + element.second->GetRawSize();
+    }
+    return size;
+}
 
-        dictContainerPbMsg.add_element()->CopyFrom(subDataContainer);
+uint64_t
+OpenGymDictContainer::WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name)
+{
+    Ns3AiGymRawNode node = {};
+    node.m_type = ns3_ai_gym::Dict;
+    node.m_count = m_dict.size();
+    uint64_t payload = WriteRawName(buffer, offset, node, name);
+    uint64_t* children = reinterpret_cast<uint64_t*>(buffer + payload);
+    uint64_t end = payload + m_dict.size() * sizeof(uint64_t);
+    for (const auto& element : m_dict)
+    {
+        *children++ = end;
+        end = element.second->WriteRaw(buffer, end, element.first);
     }
+    return WriteRawNode(buffer, offset, node, end);
+}
 
-    dataContainerPbMsg.mutable_data()->PackFrom(dictContainerPbMsg);
-    return dataContainerPbMsg;
+bool
+OpenGymDictContainer::SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset)
+{
+    const uint64_t* children = GetRawChildren(buffer, size, offset);
+    if (!children)
+    {
+        return false;
+    }
+    const Ns3AiGymRawNode* node = reinterpret_cast<const Ns3AiGymRawNode*>(buffer + offset);
+    if (node->m_type != ns3_ai_gym::Dict || node->m_count != m_dict.size())
+    {
+        return false;
+    }
+    for (uint64_t i = 0; i < node->m_count; ++i)
+    {
+        if (!Ns3AiGymRawCheckedPayload(buffer, size, children[i], 0))
+        {
+            return false;
+        }
+        const Ns3AiGymRawNode* child =
+            reinterpret_cast<const Ns3AiGymRawNode*>(buffer + children[i]);
+        m_rawName.assign(reinterpret_cast<const char*>(child + 1), child->m_nameLength);
+        auto it = m_dict.find(m_rawName);
+        if (it == m_dict.end() || !it->second->SetFromRaw(buffer, size, children[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+OpenGymDictContainer::WriteFlat(uint8_t* data,
+                                const Ns3AiGymFlatField*& field,
+                                const Ns3AiGymFlatField* end)
+{
+    // sorted by name, like the elements of the space
+    for (const auto& element : m_dict)
+    {
+        element.second->WriteFlat(data, field, end);
+    }
+}
+
+void
+OpenGymDictContainer::Clear()
+{
+    // map nodes are freed, so a Dict allocates when filled again
+    m_dict.clear();
+}
+
+void
+OpenGymDictContainer::AppendValues(std::vector<double>& values) const
+{
+    for (const auto& element : m_dict)
+    {
+        element.second->AppendValues(values);
+    }
+}
+
+void
+OpenGymDictContainer::Normalize(OpenGymNormalizer& normalizer)
+{
+    for (const auto& element : m_dict)
+    {
+        element.second->Normalize(normalizer);
+    }
 }
 
 bool
@@ -22,14 +22,71 @@
 #ifndef OPENGYM_CONTAINER_H
 #define OPENGYM_CONTAINER_H
 
+#include "../ns3-ai-gym-raw.h"
 #include "messages.pb.h"
+#include "ns3-ai-gym-normalizer.h"
+#include "spaces.h"
 
+#include <ns3/abort.h>
 #include <ns3/object.h>
 #include <ns3/type-name.h>
 
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
 namespace ns3
 {
 
+/**
+ * \brief Non-owning view of contiguous container data, a subset of
+ * C++20 std::span
+ */
+template <typename T>
+class OpenGymSpan
+{
+  public:
+    OpenGymSpan(T* data, std::size_t size)
+        : m_data(data),
+          m_size(size)
+    {
+    }
+
+    T* data() const
+    {
+        return m_data;
+    };
+
+    std::size_t size() const
+    {
+        return m_size;
+    };
+
+    bool empty() const
+    {
+        return m_size == 0;
+    };
+
+    T& operator[](std::size_t idx) const
+    {
+        return m_data[idx];
+    };
+
+    T* begin() const
+    {
+        return m_data;
+    };
+
+    T* end() const
+    {
+        return m_data + m_size;
+    };
+
+  private:
+    T* m_data;
+    std::size_t m_size;
+};
+
 class OpenGymDataContainer : public Object
 {
   public:
@@ -40,7 +97,79 @@ class OpenGymDataContainer : public Object
 
     virtual ns3_ai_gym::DataContainer GetDataContainerPbMsg() = 0;
     static Ptr<OpenGymDataContainer> CreateFromDataContainerPbMsg(
-        ns3_ai_gym::DataContainer& dataContainer);
+        const ns3_ai_gym::DataContainer& dataContainer);
+
+    /**
+     * Fills a message that is reused across steps. Unlike
+     * GetDataContainerPbMsg, built-in containers keep the memory of the
+     * message and of their own scratch messages, so no memory is
+     * allocated once they have grown to size.
+     */
+    virtual void FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer);
+
+    /**
+     * Updates this container in place from a message of the same
+     * structure. Returns false if the structure differs, in which case
+     * CreateFromDataContainerPbMsg must be used instead.
+     */
+    virtual bool SetFromDataContainerPbMsg(const ns3_ai_gym::DataContainer& dataContainer);
+
+    /**
+     * Gets the size in bytes of this container as a raw node, see
+     * ns3-ai-gym-raw.h, not counting its name
+     */
+    virtual uint64_t GetRawSize();
+
+    /**
+     * Writes this container as a raw node at the given offset of
+     * buffer, and returns the offset after it
+     */
+    virtual uint64_t WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name);
+
+    /**
+     * Creates a container from the raw node at the given offset of a
+     * message of size bytes, or returns nullptr if the node is not
+     * supported or does not fit in the message
+     */
+    static Ptr<OpenGymDataContainer> CreateFromRaw(const uint8_t* buffer,
+                                                   uint64_t size,
+                                                   uint64_t offset);
+
+    /**
+     * Updates this container in place from a raw node of the same
+     * structure, like SetFromDataContainerPbMsg. Returns false if the
+     * node differs or does not fit in the message of size bytes.
+     */
+    virtual bool SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset);
+
+    /**
+     * Writes the elements of this container in the flat format, see
+     * ns3-ai-gym-raw.h, from field onwards of the schema ending at end.
+     * field is moved past the fields written.
+     */
+    virtual void WriteFlat(uint8_t* data,
+                           const Ns3AiGymFlatField*& field,
+                           const Ns3AiGymFlatField* end);
+
+    /**
+     * Removes the data of this container but keeps its memory, so that
+     * it can be filled again without allocating, see
+     * OpenGymInterface::GetPooledContainer
+     */
+    virtual void Clear();
+
+    /**
+     * Appends the elements of this container to values, Tuple and Dict
+     * elements in order. Used to compare observations, see
+     * OpenGymInterface.
+     */
+    virtual void AppendValues(std::vector<double>& values) const;
+
+    /**
+     * Normalizes the floating-point elements of this container in
+     * place, in the order of AppendValues, see OpenGymNormalizer
+     */
+    virtual void Normalize(OpenGymNormalizer& normalizer);
 
     virtual void Print(std::ostream& where) const = 0;
 
@@ -54,6 +183,41 @@ class OpenGymDataContainer : public Object
     // Inherited
     void DoInitialize() override;
     void DoDispose() override;
+
+    /**
+     * Same as PackFrom into the Any of dataContainer, except that the
+     * type URL is only set when it changes, so packing into a reused
+     * message allocates nothing
+     */
+    static void PackData(const google::protobuf::Message& msg,
+                         ns3_ai_gym::DataContainer& dataContainer);
+
+    /**
+     * Writes the name of a raw node at offset, and returns the offset
+     * of the node's payload
+     */
+    static uint64_t WriteRawName(uint8_t* buffer,
+                                 uint64_t offset,
+                                 Ns3AiGymRawNode& node,
+                                 const std::string& name);
+
+    /**
+     * Writes a raw node at offset whose payload ends at end, and
+     * returns end
+     */
+    static uint64_t WriteRawNode(uint8_t* buffer,
+                                 uint64_t offset,
+                                 Ns3AiGymRawNode& node,
+                                 uint64_t end);
+
+    /**
+     * Gets the next field of a flat schema, which must have the given
+     * format and count, and moves field past it
+     */
+    static const Ns3AiGymFlatField& NextFlatField(const Ns3AiGymFlatField*& field,
+                                                  const Ns3AiGymFlatField* end,
+                                                  char format,
+                                                  uint64_t count);
 };
 
 class OpenGymDiscreteContainer : public OpenGymDataContainer
@@ -66,6 +230,17 @@ class OpenGymDiscreteContainer : public OpenGymDataContainer
     static TypeId GetTypeId();
 
     ns3_ai_gym::DataContainer GetDataContainerPbMsg() override;
+    void FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer) override;
+    bool SetFromDataContainerPbMsg(const ns3_ai_gym::DataContainer& dataContainer) override;
+    uint64_t GetRawSize() override;
+    uint64_t WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name) override;
+    bool SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset) override;
+    void WriteFlat(uint8_t* data,
+                   const Ns3AiGymFlatField*& field,
+                   const Ns3AiGymFlatField* end) override;
+    void Clear() override;
+    void AppendValues(std::vector<double>& values) const override;
+    void Normalize(OpenGymNormalizer& normalizer) override;
 
     void Print(std::ostream& where) const override;
 
@@ -85,6 +260,7 @@ class OpenGymDiscreteContainer : public OpenGymDataContainer
 
     uint32_t m_n;
     uint32_t m_value;
+    ns3_ai_gym::DiscreteDataContainer m_pbMsg; //!< reused when packing and unpacking
 };
 
 template <typename T = float>
@@ -98,6 +274,17 @@ class OpenGymBoxContainer : public OpenGymDataContainer
     static TypeId GetTypeId();
 
     ns3_ai_gym::DataContainer GetDataContainerPbMsg() override;
+    void FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer) override;
+    bool SetFromDataContainerPbMsg(const ns3_ai_gym::DataContainer& dataContainer) override;
+    uint64_t GetRawSize() override;
+    uint64_t WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name) override;
+    bool SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset) override;
+    void WriteFlat(uint8_t* data,
+                   const Ns3AiGymFlatField*& field,
+                   const Ns3AiGymFlatField* end) override;
+    void Clear() override;
+    void AppendValues(std::vector<double>& values) const override;
+    void Normalize(OpenGymNormalizer& normalizer) override;
 
     void Print(std::ostream& where) const override;
 
@@ -108,12 +295,30 @@ class OpenGymBoxContainer : public OpenGymDataContainer
     }
 
     bool AddValue(T value);
-    T GetValue(uint32_t idx);
-
-    bool SetData(std::vector<T> data);
-    std::vector<T> GetData();
-
-    std::vector<uint32_t> GetShape();
+    T GetValue(uint32_t idx) const;
+
+    bool SetData(const std::vector<T>& data);
+    bool SetData(const T* data, std::size_t size);
+    const std::vector<T>& GetData() const;
+
+    /**
+     * Gets a view to modify the data in place. Not available for bool,
+     * whose std::vector is packed.
+     */
+    OpenGymSpan<T> GetMutableData();
+
+    /**
+     * Resizes the data, keeping its memory, and gets a view to write it
+     * in place. New elements are zero. Not available for bool.
+     */
+    OpenGymSpan<T> ResizeData(std::size_t size);
+
+    /**
+     * Sets the shape and reserves memory for its elements, so that
+     * AddValue does not allocate
+     */
+    void SetShape(const std::vector<uint32_t>& shape);
+    const std::vector<uint32_t>& GetShape() const;
 
   protected:
     // Inherited
@@ -122,9 +327,33 @@ class OpenGymBoxContainer : public OpenGymDataContainer
 
   private:
     void SetDtype();
+
+    /**
+     * Copies into a repeated field without reallocating it, unless
+     * it grows
+     */
+    template <typename U, typename F>
+    static void CopyToField(const std::vector<U>& src, google::protobuf::RepeatedField<F>* dst);
+
+    /**
+     * Copies 8 and 16-bit data as little-endian bytes, and booleans as
+     * one bit per element, into packedData
+     */
+    template <typename U>
+    static void CopyToBytes(const std::vector<U>& src, std::string* dst);
+    static void CopyToBytes(const std::vector<bool>& src, std::string* dst);
+
+    /**
+     * Copies count elements from packedData, see CopyToBytes
+     */
+    template <typename U>
+    static void CopyFromBytes(const std::string& src, uint32_t count, std::vector<U>* dst);
+    static void CopyFromBytes(const std::string& src, uint32_t count, std::vector<bool>* dst);
+
     std::vector<uint32_t> m_shape;
     ns3_ai_gym::Dtype m_dtype;
     std::vector<T> m_data;
+    ns3_ai_gym::BoxDataContainer m_pbMsg; //!< reused when packing and unpacking
 };
 
 template <typename T>
@@ -147,9 +376,9 @@ OpenGymBoxContainer<T>::OpenGymBoxContainer()
 
 template <typename T>
 OpenGymBoxContainer<T>::OpenGymBoxContainer(std::vector<uint32_t> shape)
-    : m_shape(shape)
 {
     SetDtype();
+    SetShape(shape);
 }
 
 template <typename T>
@@ -161,27 +390,7 @@ template <typename T>
 void
 OpenGymBoxContainer<T>::SetDtype()
 {
-    std::string name = TypeNameGet<T>();
-    if (name == "int8_t" || name == "int16_t" || name == "int32_t" || name == "int64_t")
-    {
-        m_dtype = ns3_ai_gym::INT;
-    }
-    else if (name == "uint8_t" || name == "uint16_t" || name == "uint32_t" || name == "uint64_t")
-    {
-        m_dtype = ns3_ai_gym::UINT;
-    }
-    else if (name == "float")
-    {
-        m_dtype = ns3_ai_gym::FLOAT;
-    }
-    else if (name == "double")
-    {
-        m_dtype = ns3_ai_gym::DOUBLE;
-    }
-    else
-    {
-        m_dtype = ns3_ai_gym::FLOAT;
-    }
+    m_dtype = OpenGymDtypeOf(TypeNameGet<T>());
 }
 
 template <typename T>
@@ -196,43 +405,260 @@ OpenGymBoxContainer<T>::DoInitialize()
 {
 }
 
+template <typename T>
+template <typename U, typename F>
+void
+OpenGymBoxContainer<T>::CopyToField(const std::vector<U>& src,
+                                    google::protobuf::RepeatedField<F>* dst)
+{
+    dst->Resize(src.size(), 0);
+    std::copy(src.begin(), src.end(), dst->mutable_data());
+}
+
+template <typename T>
+template <typename U>
+void
+OpenGymBoxContainer<T>::CopyToBytes(const std::vector<U>& src, std::string* dst)
+{
+    dst->resize(src.size() * sizeof(U));
+    std::memcpy(&(*dst)[0], src.data(), dst->size());
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::CopyToBytes(const std::vector<bool>& src, std::string* dst)
+{
+    dst->assign((src.size() + 7) / 8, 0);
+    for (std::size_t i = 0; i < src.size(); ++i)
+    {
+        if (src[i])
+        {
+            (*dst)[i / 8] |= char(1 << (i % 8));
+        }
+    }
+}
+
+template <typename T>
+template <typename U>
+void
+OpenGymBoxContainer<T>::CopyFromBytes(const std::string& src, uint32_t count, std::vector<U>* dst)
+{
+    dst->resize(std::min<std::size_t>(count, src.size() / sizeof(U)));
+    std::memcpy(dst->data(), src.data(), dst->size() * sizeof(U));
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::CopyFromBytes(const std::string& src,
+                                      uint32_t count,
+                                      std::vector<bool>* dst)
+{
+    dst->resize(std::min<std::size_t>(count, src.size() * 8));
+    for (std::size_t i = 0; i < dst->size(); ++i)
+    {
+        (*dst)[i] = (src[i / 8] >> (i % 8)) & 1;
+    }
+}
+
 template <typename T>
 ns3_ai_gym::DataContainer
 OpenGymBoxContainer<T>::GetDataContainerPbMsg()
 {
     ns3_ai_gym::DataContainer dataContainerPbMsg;
-    ns3_ai_gym::BoxDataContainer boxContainerPbMsg;
-
-    std::vector<uint32_t> shape = GetShape();
-    *boxContainerPbMsg.mutable_shape() = {shape.begin(), shape.end()};
+    FillDataContainerPbMsg(dataContainerPbMsg);
+    return dataContainerPbMsg;
+}
 
-    boxContainerPbMsg.set_dtype(m_dtype);
-    std::vector<T> data = GetData();
+template <typename T>
+void
+OpenGymBoxContainer<T>::FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer)
+{
+    CopyToField(m_shape, m_pbMsg.mutable_shape());
+    m_pbMsg.set_dtype(m_dtype);
 
     if (m_dtype == ns3_ai_gym::INT)
     {
-        *boxContainerPbMsg.mutable_intdata() = {data.begin(), data.end()};
+        CopyToField(m_data, m_pbMsg.mutable_intdata());
     }
     else if (m_dtype == ns3_ai_gym::UINT)
     {
-        *boxContainerPbMsg.mutable_uintdata() = {data.begin(), data.end()};
+        CopyToField(m_data, m_pbMsg.mutable_uintdata());
     }
     else if (m_dtype == ns3_ai_gym::FLOAT)
     {
-        *boxContainerPbMsg.mutable_floatdata() = {data.begin(), data.end()};
+        CopyToField(m_data, m_pbMsg.mutable_floatdata());
     }
     else if (m_dtype == ns3_ai_gym::DOUBLE)
     {
-        *boxContainerPbMsg.mutable_doubledata() = {data.begin(), data.end()};
+        CopyToField(m_data, m_pbMsg.mutable_doubledata());
+    }
+    else if (m_dtype == ns3_ai_gym::INT64)
+    {
+        CopyToField(m_data, m_pbMsg.mutable_int64data());
+    }
+    else if (m_dtype == ns3_ai_gym::UINT64)
+    {
+        CopyToField(m_data, m_pbMsg.mutable_uint64data());
+    }
+    else if (m_dtype == ns3_ai_gym::INT8 || m_dtype == ns3_ai_gym::INT16 ||
+             m_dtype == ns3_ai_gym::UINT8 || m_dtype == ns3_ai_gym::UINT16 ||
+             m_dtype == ns3_ai_gym::BOOL)
+    {
+        CopyToBytes(m_data, m_pbMsg.mutable_packeddata());
+        m_pbMsg.set_packedcount(m_data.size());
     }
     else
     {
-        *boxContainerPbMsg.mutable_floatdata() = {data.begin(), data.end()};
+        CopyToField(m_data, m_pbMsg.mutable_floatdata());
     }
 
-    dataContainerPbMsg.set_type(ns3_ai_gym::Box);
-    dataContainerPbMsg.mutable_data()->PackFrom(boxContainerPbMsg);
-    return dataContainerPbMsg;
+    dataContainer.set_type(ns3_ai_gym::Box);
+    PackData(m_pbMsg, dataContainer);
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::SetFromDataContainerPbMsg(const ns3_ai_gym::DataContainer& dataContainer)
+{
+    if (dataContainer.type() != ns3_ai_gym::Box || !dataContainer.data().UnpackTo(&m_pbMsg) ||
+        m_pbMsg.dtype() != m_dtype)
+    {
+        return false;
+    }
+    m_shape.assign(m_pbMsg.shape().begin(), m_pbMsg.shape().end());
+
+    if (m_dtype == ns3_ai_gym::INT)
+    {
+        m_data.assign(m_pbMsg.intdata().begin(), m_pbMsg.intdata().end());
+    }
+    else if (m_dtype == ns3_ai_gym::UINT)
+    {
+        m_data.assign(m_pbMsg.uintdata().begin(), m_pbMsg.uintdata().end());
+    }
+    else if (m_dtype == ns3_ai_gym::DOUBLE)
+    {
+        m_data.assign(m_pbMsg.doubledata().begin(), m_pbMsg.doubledata().end());
+    }
+    else if (m_dtype == ns3_ai_gym::INT64)
+    {
+        m_data.assign(m_pbMsg.int64data().begin(), m_pbMsg.int64data().end());
+    }
+    else if (m_dtype == ns3_ai_gym::UINT64)
+    {
+        m_data.assign(m_pbMsg.uint64data().begin(), m_pbMsg.uint64data().end());
+    }
+    else if (m_dtype == ns3_ai_gym::INT8 || m_dtype == ns3_ai_gym::INT16 ||
+             m_dtype == ns3_ai_gym::UINT8 || m_dtype == ns3_ai_gym::UINT16 ||
+             m_dtype == ns3_ai_gym::BOOL)
+    {
+        CopyFromBytes(m_pbMsg.packeddata(), m_pbMsg.packedcount(), &m_data);
+    }
+    else
+    {
+        m_data.assign(m_pbMsg.floatdata().begin(), m_pbMsg.floatdata().end());
+    }
+    return true;
+}
+
+template <typename T>
+uint64_t
+OpenGymBoxContainer<T>::GetRawSize()
+{
+    return sizeof(Ns3AiGymRawNode) + Ns3AiGymRawAlign(m_data.size() * sizeof(T));
+}
+
+template <typename T>
+uint64_t
+OpenGymBoxContainer<T>::WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name)
+{
+    NS_ABORT_MSG_IF(m_shape.size() > NS3AI_GYM_RAW_MAX_RANK,
+                    "Box of rank " << m_shape.size() << " cannot be written as a raw node");
+    Ns3AiGymRawNode node = {};
+    node.m_type = ns3_ai_gym::Box;
+    node.m_format = Ns3AiColumnFormat<T>::value;
+    node.m_itemSize = sizeof(T);
+    node.m_rank = m_shape.size();
+    std::copy(m_shape.begin(), m_shape.end(), node.m_shape);
+    node.m_count = m_data.size();
+    uint64_t bytes = m_data.size() * sizeof(T);
+    uint64_t payload = WriteRawName(buffer, offset, node, name);
+    if constexpr (std::is_same<T, bool>::value)
+    {
+        // std::vector<bool> is packed, raw booleans are one byte each
+        std::copy(m_data.begin(), m_data.end(), reinterpret_cast<bool*>(buffer + payload));
+    }
+    else
+    {
+        std::memcpy(buffer + payload, m_data.data(), bytes);
+    }
+    return WriteRawNode(buffer, offset, node, payload + Ns3AiGymRawAlign(bytes));
+}
+
+template <typename T>
+bool
+OpenGymBoxContainer<T>::SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset)
+{
+    uint64_t payload = Ns3AiGymRawCheckedPayload(buffer, size, offset, sizeof(T));
+    if (!payload)
+    {
+        return false;
+    }
+    const Ns3AiGymRawNode* node = reinterpret_cast<const Ns3AiGymRawNode*>(buffer + offset);
+    if (node->m_type != ns3_ai_gym::Box || node->m_format != Ns3AiColumnFormat<T>::value ||
+        node->m_rank > NS3AI_GYM_RAW_MAX_RANK)
+    {
+        return false;
+    }
+    m_shape.assign(node->m_shape, node->m_shape + node->m_rank);
+    const T* data = reinterpret_cast<const T*>(buffer + payload);
+    m_data.assign(data, data + node->m_count);
+    return true;
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::WriteFlat(uint8_t* data,
+                                  const Ns3AiGymFlatField*& field,
+                                  const Ns3AiGymFlatField* end)
+{
+    const Ns3AiGymFlatField& flat =
+        NextFlatField(field, end, Ns3AiColumnFormat<T>::value, m_data.size());
+    if constexpr (std::is_same<T, bool>::value)
+    {
+        std::copy(m_data.begin(), m_data.end(), reinterpret_cast<bool*>(data + flat.m_offset));
+    }
+    else
+    {
+        std::memcpy(data + flat.m_offset, m_data.data(), m_data.size() * sizeof(T));
+    }
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::Clear()
+{
+    m_data.clear();
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::AppendValues(std::vector<double>& values) const
+{
+    values.insert(values.end(), m_data.begin(), m_data.end());
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::Normalize(OpenGymNormalizer& normalizer)
+{
+    if constexpr (std::is_floating_point<T>::value)
+    {
+        normalizer.Normalize(m_data.data(), m_data.size());
+    }
+    else
+    {
+        normalizer.Skip(m_data.size());
+    }
 }
 
 template <typename T>
@@ -245,7 +671,7 @@ OpenGymBoxContainer<T>::AddValue(T value)
 
 template <typename T>
 T
-OpenGymBoxContainer<T>::GetValue(uint32_t idx)
+OpenGymBoxContainer<T>::GetValue(uint32_t idx) const
 {
     T data = 0;
     if (idx < m_data.size())
@@ -257,26 +683,66 @@ OpenGymBoxContainer<T>::GetValue(uint32_t idx)
 
 template <typename T>
 bool
-OpenGymBoxContainer<T>::SetData(std::vector<T> data)
+OpenGymBoxContainer<T>::SetData(const std::vector<T>& data)
 {
-    m_data = data;
+    m_data.assign(data.begin(), data.end());
     return true;
 }
 
 template <typename T>
-std::vector<uint32_t>
-OpenGymBoxContainer<T>::GetShape()
+bool
+OpenGymBoxContainer<T>::SetData(const T* data, std::size_t size)
 {
-    return m_shape;
+    m_data.assign(data, data + size);
+    return true;
 }
 
 template <typename T>
-std::vector<T>
-OpenGymBoxContainer<T>::GetData()
+const std::vector<T>&
+OpenGymBoxContainer<T>::GetData() const
 {
     return m_data;
 }
 
+template <typename T>
+OpenGymSpan<T>
+OpenGymBoxContainer<T>::GetMutableData()
+{
+    static_assert(!std::is_same<T, bool>::value,
+                  "std::vector<bool> is packed, use SetData or AddValue for bool Boxes");
+    return OpenGymSpan<T>(m_data.data(), m_data.size());
+}
+
+template <typename T>
+OpenGymSpan<T>
+OpenGymBoxContainer<T>::ResizeData(std::size_t size)
+{
+    static_assert(!std::is_same<T, bool>::value,
+                  "std::vector<bool> is packed, use SetData or AddValue for bool Boxes");
+    m_data.resize(size);
+    return GetMutableData();
+}
+
+template <typename T>
+void
+OpenGymBoxContainer<T>::SetShape(const std::vector<uint32_t>& shape)
+{
+    m_shape.assign(shape.begin(), shape.end());
+    std::size_t count = 1;
+    for (uint32_t dim : shape)
+    {
+        count *= dim;
+    }
+    m_data.reserve(count);
+}
+
+template <typename T>
+const std::vector<uint32_t>&
+OpenGymBoxContainer<T>::GetShape() const
+{
+    return m_shape;
+}
+
 template <typename T>
 void
 OpenGymBoxContainer<T>::Print(std::ostream& where) const
@@ -304,6 +770,17 @@ class OpenGymTupleContainer : public OpenGymDataContainer
     static TypeId GetTypeId();
 
     ns3_ai_gym::DataContainer GetDataContainerPbMsg() override;
+    void FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer) override;
+    bool SetFromDataContainerPbMsg(const ns3_ai_gym::DataContainer& dataContainer) override;
+    uint64_t GetRawSize() override;
+    uint64_t WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name) override;
+    bool SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset) override;
+    void WriteFlat(uint8_t* data,
+                   const Ns3AiGymFlatField*& field,
+                   const Ns3AiGymFlatField* end) override;
+    void Clear() override;
+    void AppendValues(std::vector<double>& values) const override;
+    void Normalize(OpenGymNormalizer& normalizer) override;
 
     void Print(std::ostream& where) const override;
 
@@ -322,6 +799,7 @@ class OpenGymTupleContainer : public OpenGymDataContainer
     void DoDispose() override;
 
     std::vector<Ptr<OpenGymDataContainer>> m_tuple;
+    ns3_ai_gym::TupleDataContainer m_pbMsg; //!< reused when packing and unpacking
 };
 
 class OpenGymDictContainer : public OpenGymDataContainer
@@ -333,6 +811,17 @@ class OpenGymDictContainer : public OpenGymDataContainer
     static TypeId GetTypeId();
 
     ns3_ai_gym::DataContainer GetDataContainerPbMsg() override;
+    void FillDataContainerPbMsg(ns3_ai_gym::DataContainer& dataContainer) override;
+    bool SetFromDataContainerPbMsg(const ns3_ai_gym::DataContainer& dataContainer) override;
+    uint64_t GetRawSize() override;
+    uint64_t WriteRaw(uint8_t* buffer, uint64_t offset, const std::string& name) override;
+    bool SetFromRaw(const uint8_t* buffer, uint64_t size, uint64_t offset) override;
+    void WriteFlat(uint8_t* data,
+                   const Ns3AiGymFlatField*& field,
+                   const Ns3AiGymFlatField* end) override;
+    void Clear() override;
+    void AppendValues(std::vector<double>& values) const override;
+    void Normalize(OpenGymNormalizer& normalizer) override;
 
     void Print(std::ostream& where) const override;
 
@@ -351,6 +840,8 @@ class OpenGymDictContainer : public OpenGymDataContainer
     void DoDispose() override;
 
     std::map<std::string, Ptr<OpenGymDataContainer>> m_dict;
+    ns3_ai_gym::DictDataContainer m_pbMsg; //!< reused when packing and unpacking
+    std::string m_rawName;                 //!< reused when looking up raw elements
 };
 
 } // end of namespace ns3
@@ -84,6 +84,16 @@ OpenGymEnv::NotifySimulationEnd()
     }
 }
 
+void
+OpenGymEnv::ForkEpisodes()
+{
+    NS_LOG_FUNCTION(this);
+    if (m_openGymInterface)
+    {
+        m_openGymInterface->ForkEpisodes();
+    }
+}
+
 void
 OpenGymEnv::DoInitialize()
 {
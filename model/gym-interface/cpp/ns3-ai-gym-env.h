@@ -82,18 +82,23 @@ class OpenGymEnv : public Object
      * Sets the lower level gym interface (shared memory)
      * associated to the environment
      */
-    void SetOpenGymInterface(Ptr<OpenGymInterface> openGymInterface);
+    virtual void SetOpenGymInterface(Ptr<OpenGymInterface> openGymInterface);
 
     /**
      * Notify Python side about the states, and execute the actions
      */
-    void Notify();
+    virtual void Notify();
 
     /**
      * Notify Python side that the simulation has ended.
      */
     void NotifySimulationEnd();
 
+    /**
+     * Forks a child process per episode, see OpenGymInterface::ForkEpisodes
+     */
+    void ForkEpisodes();
+
   protected:
     // Inherited
     void DoInitialize() override;
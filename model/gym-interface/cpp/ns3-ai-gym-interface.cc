@@ -29,18 +29,131 @@
 #include "container.h"
 #include "messages.pb.h"
 #include "ns3-ai-gym-env.h"
+#include "ns3-ai-gym-multi-agent-env.h"
 #include "spaces.h"
 
+#include <ns3/abort.h>
 #include <ns3/config.h>
 #include <ns3/log.h>
+#include <ns3/rng-seed-manager.h>
 #include <ns3/simulator.h>
 
+#include <google/protobuf/io/coded_stream.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
 namespace ns3
 {
 
 NS_LOG_COMPONENT_DEFINE("OpenGymInterface");
 NS_OBJECT_ENSURE_REGISTERED(OpenGymInterface);
 
+/**
+ * Gets the element type of a Box dtype, see Ns3AiColumnFormat
+ */
+static char
+DtypeFormat(ns3_ai_gym::Dtype dtype)
+{
+    switch (dtype)
+    {
+    case ns3_ai_gym::BOOL:
+        return Ns3AiColumnFormat<bool>::value;
+    case ns3_ai_gym::INT8:
+        return Ns3AiColumnFormat<int8_t>::value;
+    case ns3_ai_gym::INT16:
+        return Ns3AiColumnFormat<int16_t>::value;
+    case ns3_ai_gym::INT:
+        return Ns3AiColumnFormat<int32_t>::value;
+    case ns3_ai_gym::INT64:
+        return Ns3AiColumnFormat<int64_t>::value;
+    case ns3_ai_gym::UINT8:
+        return Ns3AiColumnFormat<uint8_t>::value;
+    case ns3_ai_gym::UINT16:
+        return Ns3AiColumnFormat<uint16_t>::value;
+    case ns3_ai_gym::UINT:
+        return Ns3AiColumnFormat<uint32_t>::value;
+    case ns3_ai_gym::UINT64:
+        return Ns3AiColumnFormat<uint64_t>::value;
+    case ns3_ai_gym::DOUBLE:
+        return Ns3AiColumnFormat<double>::value;
+    default:
+        return Ns3AiColumnFormat<float>::value;
+    }
+}
+
+/**
+ * Appends the Boxes and Discretes of a space to a flat schema, laid
+ * out one after the other
+ */
+static void
+CompileFlatSchema(const ns3_ai_gym::SpaceDescription& space, ns3_ai_gym::FlatSchema& schema)
+{
+    if (space.type() == ns3_ai_gym::Discrete || space.type() == ns3_ai_gym::Box)
+    {
+        ns3_ai_gym::FlatField* field = schema.add_fields();
+        uint32_t itemSize = sizeof(uint32_t);
+        field->set_dtype(ns3_ai_gym::UINT);
+        field->set_count(1);
+        if (space.type() == ns3_ai_gym::Box)
+        {
+            ns3_ai_gym::BoxSpace box;
+            space.space().UnpackTo(&box);
+            uint64_t count = 1;
+            for (uint32_t dim : box.shape())
+            {
+                count *= dim;
+            }
+            field->set_dtype(box.dtype());
+            *field->mutable_shape() = box.shape();
+            field->set_count(count);
+            switch (DtypeFormat(box.dtype()))
+            {
+            case '?':
+            case 'b':
+            case 'B':
+                itemSize = 1;
+                break;
+            case 'h':
+            case 'H':
+                itemSize = 2;
+                break;
+            case 'q':
+            case 'Q':
+            case 'd':
+                itemSize = 8;
+                break;
+            }
+        }
+        field->set_offset(schema.size());
+        schema.set_size(schema.size() + Ns3AiGymRawAlign(field->count() * itemSize));
+    }
+    else if (space.type() == ns3_ai_gym::Tuple)
+    {
+        ns3_ai_gym::TupleSpace tuple;
+        space.space().UnpackTo(&tuple);
+        for (const ns3_ai_gym::SpaceDescription& element : tuple.element())
+        {
+            CompileFlatSchema(element, schema);
+        }
+    }
+    else if (space.type() == ns3_ai_gym::Dict)
+    {
+        ns3_ai_gym::DictSpace dict;
+        space.space().UnpackTo(&dict);
+        for (const ns3_ai_gym::SpaceDescription& element : dict.element())
+        {
+            CompileFlatSchema(element, schema);
+        }
+    }
+}
+
 Ptr<OpenGymInterface>
 OpenGymInterface::Get()
 {
@@ -51,12 +164,22 @@ OpenGymInterface::Get()
 OpenGymInterface::OpenGymInterface()
     : m_simEnd(false),
       m_stopEnvRequested(false),
-      m_initSimMsgSent(false)
+      m_initSimMsgSent(false),
+      m_episodeServer(false),
+      m_episodeLoop(false),
+      m_episodeFailed(false),
+      m_msgInterface(nullptr),
+      m_wireFormat(ns3_ai_gym::PROTOBUF),
+      m_flatSize(0),
+      m_flatDelta(false),
+      m_holdSteps(0),
+      m_holdUntil(0),
+      m_heldReward(0),
+      m_heldReceived(false),
+      m_useTrigger(false)
 {
-    auto interface = Ns3AiMsgInterface::Get();
-    interface->SetIsMemoryCreator(false);
-    interface->SetUseVector(false);
-    interface->SetHandleFinish(false);
+    m_envStateMsg = google::protobuf::Arena::Create<ns3_ai_gym::EnvStateMsg>(&m_arena);
+    m_envActMsg = google::protobuf::Arena::Create<ns3_ai_gym::EnvActMsg>(&m_arena);
 }
 
 OpenGymInterface::~OpenGymInterface()
@@ -73,6 +196,24 @@ OpenGymInterface::GetTypeId()
     return tid;
 }
 
+Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>*
+OpenGymInterface::GetMsgInterface()
+{
+    if (!m_msgInterface)
+    {
+        // the gym channel has its own settings and segment, whatever the setters and SetNames
+        // of other channels did, but for how this side waits and records latency
+        auto interface = Ns3AiMsgInterface::Get();
+        Ns3AiMsgChannelSettings settings;
+        settings.m_waitPolicy = interface->GetSettings().m_waitPolicy;
+        settings.m_spinCount = interface->GetSettings().m_spinCount;
+        settings.m_statsEnabled = interface->GetSettings().m_statsEnabled;
+        m_msgInterface = interface->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>(
+            Ns3AiMsgInterface::GetDefaultSegmentName(), settings);
+    }
+    return m_msgInterface;
+}
+
 void
 OpenGymInterface::Init()
 {
@@ -83,44 +224,73 @@ OpenGymInterface::Init()
     }
     m_initSimMsgSent = true;
 
-    Ptr<OpenGymSpace> obsSpace = GetObservationSpace();
-    Ptr<OpenGymSpace> actionSpace = GetActionSpace();
-
     ns3_ai_gym::SimInitMsg simInitMsg;
-    if (obsSpace)
-    {
-        ns3_ai_gym::SpaceDescription spaceDesc;
-        spaceDesc = obsSpace->GetSpaceDescription();
-        simInitMsg.mutable_obsspace()->CopyFrom(spaceDesc);
-    }
-    if (actionSpace)
+    DescribeSpaces(simInitMsg);
+    simInitMsg.add_wireformats(ns3_ai_gym::PROTOBUF);
+    // the raw header has no room for the states of agents
+    if (m_agentStatesCb.IsNull())
     {
-        ns3_ai_gym::SpaceDescription spaceDesc;
-        spaceDesc = actionSpace->GetSpaceDescription();
-        simInitMsg.mutable_actspace()->CopyFrom(spaceDesc);
+        simInitMsg.add_wireformats(ns3_ai_gym::RAW);
+        if (simInitMsg.has_obsspace())
+        {
+            CompileFlatSchema(simInitMsg.obsspace(), *simInitMsg.mutable_obsschema());
+            simInitMsg.add_wireformats(ns3_ai_gym::FLAT);
+            simInitMsg.set_flatdelta(true);
+        }
     }
+    simInitMsg.set_multiagent(!m_agentStatesCb.IsNull());
+    simInitMsg.set_episodeserver(m_episodeServer);
 
     // get the interface
-    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface =
-        Ns3AiMsgInterface::Get()->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface = GetMsgInterface();
 
     // send init msg to python
     msgInterface->CppSendBegin();
-    msgInterface->GetCpp2PyStruct()->size = simInitMsg.ByteSizeLong();
-    assert(msgInterface->GetCpp2PyStruct()->size <= MSG_BUFFER_SIZE);
-    simInitMsg.SerializeToArray(msgInterface->GetCpp2PyStruct()->buffer,
-                                msgInterface->GetCpp2PyStruct()->size);
+    Ns3AiGymMsg* request = msgInterface->GetCpp2PyStruct();
+    std::size_t size = simInitMsg.ByteSizeLong();
+    NS_ABORT_MSG_IF(size > request->capacity,
+                    "Init message of " << size << " bytes exceeds the buffer of "
+                                       << request->capacity << " bytes, increase shmSize");
+    request->size = size;
+    simInitMsg.SerializeWithCachedSizesToArray(request->buffer.get());
     msgInterface->CppSendEnd();
 
     // receive init ack msg from python
     ns3_ai_gym::SimInitAck simInitAck;
     msgInterface->CppRecvBegin();
-    simInitAck.ParseFromArray(msgInterface->GetPy2CppStruct()->buffer,
-                              msgInterface->GetPy2CppStruct()->size);
+    Ns3AiGymMsg* reply = msgInterface->GetPy2CppStruct();
+    simInitAck.ParseFromArray(reply->buffer.get(), reply->size);
     msgInterface->CppRecvEnd();
 
     bool done = simInitAck.done();
     NS_LOG_DEBUG("Sim Init Ack: " << done);
+    // Python side that predates the raw format leaves this as protobuf
+    m_wireFormat = simInitAck.wireformat();
+    NS_LOG_DEBUG("Wire format: " << ns3_ai_gym::WireFormat_Name(m_wireFormat));
+    m_flatSchema.clear();
+    for (const ns3_ai_gym::FlatField& field : simInitMsg.obsschema().fields())
+    {
+        m_flatSchema.push_back({field.offset(), field.count(), DtypeFormat(field.dtype())});
+    }
+    m_flatSize = simInitMsg.obsschema().size();
+    m_flatDelta = m_wireFormat == ns3_ai_gym::FLAT && simInitAck.flatdelta();
+    m_flatSent.clear();
+    m_useTrigger = simInitAck.has_trigger();
+    m_trigger = simInitAck.trigger();
+    if (m_useTrigger)
+    {
+        // without any condition, no observation would be sent after the first one
+        bool threshold = std::any_of(m_trigger.thresholds().begin(),
+                                     m_trigger.thresholds().end(),
+                                     [](double t) { return t > 0; });
+        NS_ABORT_MSG_IF(!threshold && m_trigger.maxchange() <= 0 && m_trigger.maxsilence() <= 0,
+                        "Trigger sets no condition, set thresholds, maxChange or maxSilence");
+    }
+    if (simInitAck.has_normalization())
+    {
+        m_normalizer =
+            std::make_unique<OpenGymNormalizer>(simInitAck.normalization(), msgInterface);
+    }
     bool stopSim = simInitAck.stopsimreq();
     if (stopSim)
     {
@@ -144,56 +314,71 @@ OpenGymInterface::NotifyCurrentState()
         return;
     }
     // collect current env state
-    Ptr<OpenGymDataContainer> obsDataContainer = GetObservation();
-    float reward = GetReward();
-    bool isGameOver = IsGameOver();
-    std::string extraInfo = GetExtraInfo();
-    ns3_ai_gym::EnvStateMsg envStateMsg;
-    // observation
-    ns3_ai_gym::DataContainer obsDataContainerPbMsg;
-    if (obsDataContainer)
+    ReleasePooledContainers();
+    Ptr<OpenGymDataContainer> obsDataContainer;
+    float reward;
+    bool isGameOver;
+    if (IsHolding())
     {
-        obsDataContainerPbMsg = obsDataContainer->GetDataContainerPbMsg();
-        envStateMsg.mutable_obsdata()->CopyFrom(obsDataContainerPbMsg);
-    }
-    // reward
-    envStateMsg.set_reward(reward);
-    // game over
-    envStateMsg.set_isgameover(false);
-    if (isGameOver)
-    {
-        envStateMsg.set_isgameover(true);
-        if (m_simEnd)
+        // the last action is applied again without a round trip, unless the game is over
+        reward = GetReward();
+        isGameOver = IsGameOver();
+        if (!isGameOver)
         {
-            envStateMsg.set_reason(ns3_ai_gym::EnvStateMsg::SimulationEnd);
+            SkipNotification(reward);
+            ExecuteActions(m_actContainer);
+            return;
         }
-        else
+        obsDataContainer = GetObservation();
+    }
+    else
+    {
+        obsDataContainer = GetObservation();
+        reward = GetReward();
+        isGameOver = IsGameOver();
+        // an observation close to the last one sent is skipped like a held one
+        if (!isGameOver && !IsTriggered(obsDataContainer))
         {
-            envStateMsg.set_reason(ns3_ai_gym::EnvStateMsg::GameOver);
+            SkipNotification(reward);
+            ExecuteActions(m_actContainer);
+            return;
         }
     }
-    // extra info
-    envStateMsg.set_info(extraInfo);
+    // the reward of the skipped notifications is sent with this one
+    reward += m_heldReward;
+    m_heldReward = 0;
+    // the observation is normalized in the message, its container is left as it is
+    if (m_normalizer)
+    {
+        reward = m_normalizer->ScaleReward(reward, isGameOver);
+    }
+    std::string extraInfo = GetExtraInfo();
 
     // get the interface
-    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface =
-        Ns3AiMsgInterface::Get()->GetInterface<Ns3AiGymMsg, Ns3AiGymMsg>();
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface = GetMsgInterface();
 
-    // send env state msg to python
+    // send env state msg to python, written in place in the format chosen at init
     msgInterface->CppSendBegin();
-    msgInterface->GetCpp2PyStruct()->size = envStateMsg.ByteSizeLong();
-    assert(msgInterface->GetCpp2PyStruct()->size <= MSG_BUFFER_SIZE);
-    envStateMsg.SerializeToArray(msgInterface->GetCpp2PyStruct()->buffer,
-                                 msgInterface->GetCpp2PyStruct()->size);
-
+    Ns3AiGymMsg* request = msgInterface->GetCpp2PyStruct();
+    if (m_wireFormat == ns3_ai_gym::RAW)
+    {
+        WriteRawState(request, obsDataContainer, reward, isGameOver, extraInfo);
+    }
+    else if (m_wireFormat == ns3_ai_gym::FLAT)
+    {
+        WriteFlatState(request, obsDataContainer, reward, isGameOver, extraInfo);
+    }
+    else
+    {
+        WriteProtobufState(request, obsDataContainer, reward, isGameOver, extraInfo);
+    }
     msgInterface->CppSendEnd();
 
-    // receive act msg from python
-    ns3_ai_gym::EnvActMsg envActMsg;
+    // receive act msg from python into m_actContainer
     msgInterface->CppRecvBegin();
-
-    envActMsg.ParseFromArray(msgInterface->GetPy2CppStruct()->buffer,
-                             msgInterface->GetPy2CppStruct()->size);
+    Ns3AiGymMsg* reply = msgInterface->GetPy2CppStruct();
+    bool stopSim = m_wireFormat == ns3_ai_gym::PROTOBUF ? ReadProtobufAction(reply)
+                                                        : ReadRawAction(reply);
     msgInterface->CppRecvEnd();
 
     if (m_simEnd)
@@ -202,21 +387,376 @@ OpenGymInterface::NotifyCurrentState()
         return;
     }
 
-    bool stopSim = envActMsg.stopsimreq();
     if (stopSim)
     {
-        NS_LOG_DEBUG("---Stop requested: " << stopSim);
-        m_stopEnvRequested = true;
-        Simulator::Stop();
-        Simulator::Destroy();
-        std::exit(0);
+        // returns in the episode loop, once the simulator is told to stop
+        StopSimulation();
+        return;
     }
 
     // first step after reset is called without actions, just to get current state
-    ns3_ai_gym::DataContainer actDataContainerPbMsg = envActMsg.actdata();
-    Ptr<OpenGymDataContainer> actDataContainer =
-        OpenGymDataContainer::CreateFromDataContainerPbMsg(actDataContainerPbMsg);
-    ExecuteActions(actDataContainer);
+    ExecuteActions(m_actContainer);
+}
+
+void
+OpenGymInterface::WriteProtobufState(Ns3AiGymMsg* request,
+                                     Ptr<OpenGymDataContainer> obsDataContainer,
+                                     float reward,
+                                     bool isGameOver,
+                                     const std::string& extraInfo)
+{
+    // the message of the last step is overwritten field by field rather than
+    // cleared, which would free its sub-messages, so its memory is reused
+    ns3_ai_gym::EnvStateMsg& envStateMsg = *m_envStateMsg;
+    // observation
+    ns3_ai_gym::DataContainer* obsDataContainerPbMsg = envStateMsg.mutable_obsdata();
+    if (obsDataContainer)
+    {
+        Ptr<OpenGymDataContainer> sent = obsDataContainer;
+        if (m_normalizer)
+        {
+            // normalized in a copy, the protobuf format being the slow path anyway. Containers
+            // defined elsewhere have nothing to normalize and are sent as they are.
+            Ptr<OpenGymDataContainer> copy = OpenGymDataContainer::CreateFromDataContainerPbMsg(
+                obsDataContainer->GetDataContainerPbMsg());
+            if (copy)
+            {
+                m_normalizer->NormalizeObservation(copy);
+                sent = copy;
+            }
+        }
+        sent->FillDataContainerPbMsg(*obsDataContainerPbMsg);
+    }
+    else
+    {
+        obsDataContainerPbMsg->set_type(ns3_ai_gym::NoSpaceType);
+        obsDataContainerPbMsg->mutable_data()->Clear();
+    }
+    // reward
+    envStateMsg.set_reward(reward);
+    // game over
+    envStateMsg.set_isgameover(isGameOver);
+    envStateMsg.set_reason(GetStateReason(isGameOver));
+    // extra info
+    envStateMsg.set_info(extraInfo);
+    // states of the agents, whose messages are kept for reuse when there are fewer
+    const std::vector<OpenGymAgentState>* agentStates =
+        m_agentStatesCb.IsNull() || m_episodeFailed ? nullptr : m_agentStatesCb();
+    int agentCount = agentStates ? agentStates->size() : 0;
+    google::protobuf::RepeatedPtrField<ns3_ai_gym::AgentState>* agents =
+        envStateMsg.mutable_agents();
+    while (agents->size() > agentCount)
+    {
+        agents->RemoveLast();
+    }
+    for (int i = 0; i < agentCount; ++i)
+    {
+        const OpenGymAgentState& state = (*agentStates)[i];
+        ns3_ai_gym::AgentState* agent = i < agents->size() ? agents->Mutable(i) : agents->Add();
+        agent->set_name(state.m_name);
+        agent->set_reward(state.m_reward);
+        agent->set_isgameover(state.m_isGameOver);
+        agent->set_info(state.m_info);
+    }
+
+    // serialize in place, the buffer is sized from the segment
+    std::size_t size = envStateMsg.ByteSizeLong();
+    NS_ABORT_MSG_IF(size > request->capacity,
+                    "State message of " << size << " bytes exceeds the buffer of "
+                                        << request->capacity << " bytes, increase shmSize");
+    request->size = size;
+    envStateMsg.SerializeWithCachedSizesToArray(request->buffer.get());
+}
+
+bool
+OpenGymInterface::ReadProtobufAction(const Ns3AiGymMsg* reply)
+{
+    // merge into the message of the last step after resetting the fields
+    // that are omitted when default
+    ns3_ai_gym::EnvActMsg& envActMsg = *m_envActMsg;
+    envActMsg.set_stopsimreq(false);
+    envActMsg.set_holdsteps(0);
+    envActMsg.set_holdtime(0);
+    envActMsg.mutable_actdata()->set_type(ns3_ai_gym::NoSpaceType);
+    envActMsg.mutable_actdata()->clear_name();
+    envActMsg.mutable_actdata()->mutable_data()->Clear();
+    google::protobuf::io::CodedInputStream input(reply->buffer.get(), reply->size);
+    envActMsg.MergeFromCodedStream(&input);
+
+    const ns3_ai_gym::DataContainer& actDataContainerPbMsg = envActMsg.actdata();
+    if (!m_actContainer || !m_actContainer->SetFromDataContainerPbMsg(actDataContainerPbMsg))
+    {
+        m_actContainer = OpenGymDataContainer::CreateFromDataContainerPbMsg(actDataContainerPbMsg);
+    }
+    SetHold(envActMsg.holdsteps(), envActMsg.holdtime());
+    return envActMsg.stopsimreq();
+}
+
+void
+OpenGymInterface::WriteRawState(Ns3AiGymMsg* request,
+                                Ptr<OpenGymDataContainer> obsDataContainer,
+                                float reward,
+                                bool isGameOver,
+                                const std::string& extraInfo)
+{
+    uint64_t dataOffset = sizeof(Ns3AiGymRawHeader) + Ns3AiGymRawAlign(extraInfo.size());
+    uint64_t size = dataOffset + (obsDataContainer ? obsDataContainer->GetRawSize() : 0);
+    NS_ABORT_MSG_IF(size > request->capacity,
+                    "State message of " << size << " bytes exceeds the buffer of "
+                                        << request->capacity << " bytes, increase shmSize");
+
+    uint8_t* buffer = request->buffer.get();
+    WriteRawHeader(buffer, reward, isGameOver, extraInfo, obsDataContainer ? dataOffset : 0);
+    if (obsDataContainer)
+    {
+        obsDataContainer->WriteRaw(buffer, dataOffset, "");
+        if (m_normalizer)
+        {
+            m_normalizer->NormalizeRawObservation(buffer, dataOffset);
+        }
+    }
+    request->size = size;
+}
+
+void
+OpenGymInterface::WriteFlatState(Ns3AiGymMsg* request,
+                                 Ptr<OpenGymDataContainer> obsDataContainer,
+                                 float reward,
+                                 bool isGameOver,
+                                 const std::string& extraInfo)
+{
+    uint64_t dataOffset = sizeof(Ns3AiGymRawHeader) + Ns3AiGymRawAlign(extraInfo.size());
+    // with m_flatDelta, a keyframe is the largest message
+    uint64_t obsSize = m_flatSize + (m_flatDelta ? sizeof(Ns3AiGymDeltaHeader) : 0);
+    uint64_t size = dataOffset + (obsDataContainer ? obsSize : 0);
+    NS_ABORT_MSG_IF(size > request->capacity,
+                    "State message of " << size << " bytes exceeds the buffer of "
+                                        << request->capacity << " bytes, increase shmSize");
+
+    uint8_t* buffer = request->buffer.get();
+    WriteRawHeader(buffer, reward, isGameOver, extraInfo, obsDataContainer ? dataOffset : 0);
+    if (obsDataContainer)
+    {
+        uint8_t* data = buffer + dataOffset;
+        if (m_flatDelta)
+        {
+            m_flatCurrent.resize(m_flatSize);
+            data = m_flatCurrent.data();
+        }
+        const Ns3AiGymFlatField* field = m_flatSchema.data();
+        const Ns3AiGymFlatField* end = field + m_flatSchema.size();
+        obsDataContainer->WriteFlat(data, field, end);
+        NS_ABORT_MSG_IF(field != end, "Observation has fewer elements than its space");
+        if (m_normalizer)
+        {
+            m_normalizer->NormalizeFlatObservation(data, m_flatSchema);
+        }
+        if (m_flatDelta)
+        {
+            size = dataOffset + WriteFlatDelta(buffer + dataOffset);
+        }
+    }
+    request->size = size;
+}
+
+uint64_t
+OpenGymInterface::WriteFlatDelta(uint8_t* data)
+{
+    Ns3AiGymDeltaHeader* header = reinterpret_cast<Ns3AiGymDeltaHeader*>(data);
+    uint8_t* payload = data + sizeof(Ns3AiGymDeltaHeader);
+    uint64_t keyframeSize = m_flatCurrent.size();
+    // the changes are sent if their indices and values take less room than a keyframe
+    std::size_t maxCount = keyframeSize / (sizeof(uint32_t) + sizeof(uint64_t));
+    bool keyframe = m_flatSent.size() != m_flatCurrent.size();
+    m_flatChanged.clear();
+    if (!keyframe)
+    {
+        const uint64_t* current = reinterpret_cast<const uint64_t*>(m_flatCurrent.data());
+        const uint64_t* sent = reinterpret_cast<const uint64_t*>(m_flatSent.data());
+        std::size_t words = keyframeSize / sizeof(uint64_t);
+        for (std::size_t i = 0; i < words && !keyframe; ++i)
+        {
+            if (current[i] != sent[i])
+            {
+                m_flatChanged.push_back(i);
+                keyframe = m_flatChanged.size() >= maxCount;
+            }
+        }
+    }
+
+    uint64_t size;
+    if (keyframe)
+    {
+        header->m_keyframe = 1;
+        header->m_count = 0;
+        std::memcpy(payload, m_flatCurrent.data(), keyframeSize);
+        size = keyframeSize;
+    }
+    else
+    {
+        uint32_t count = m_flatChanged.size();
+        header->m_keyframe = 0;
+        header->m_count = count;
+        uint64_t indicesSize = Ns3AiGymRawAlign(count * sizeof(uint32_t));
+        std::memcpy(payload, m_flatChanged.data(), count * sizeof(uint32_t));
+        uint64_t* values = reinterpret_cast<uint64_t*>(payload + indicesSize);
+        const uint64_t* current = reinterpret_cast<const uint64_t*>(m_flatCurrent.data());
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            values[i] = current[m_flatChanged[i]];
+        }
+        size = indicesSize + count * sizeof(uint64_t);
+    }
+    // the observation just sent is the reference of the next one, and the buffer of the
+    // previous one is reused for it
+    m_flatSent.swap(m_flatCurrent);
+    return sizeof(Ns3AiGymDeltaHeader) + size;
+}
+
+void
+OpenGymInterface::WriteRawHeader(uint8_t* buffer,
+                                 float reward,
+                                 bool isGameOver,
+                                 const std::string& extraInfo,
+                                 uint64_t dataOffset)
+{
+    Ns3AiGymRawHeader* header = reinterpret_cast<Ns3AiGymRawHeader*>(buffer);
+    header->m_reward = reward;
+    header->m_isGameOver = isGameOver;
+    header->m_reason = GetStateReason(isGameOver);
+    header->m_stopSimReq = 0;
+    header->m_infoLength = extraInfo.size();
+    header->m_holdSteps = 0;
+    header->m_dataOffset = dataOffset;
+    header->m_holdTime = 0;
+    std::memcpy(buffer + sizeof(Ns3AiGymRawHeader), extraInfo.data(), extraInfo.size());
+}
+
+bool
+OpenGymInterface::ReadRawAction(const Ns3AiGymMsg* reply)
+{
+    NS_ABORT_MSG_IF(reply->size < sizeof(Ns3AiGymRawHeader), "Truncated raw action message");
+    const uint8_t* buffer = reply->buffer.get();
+    const Ns3AiGymRawHeader* header = reinterpret_cast<const Ns3AiGymRawHeader*>(buffer);
+    if (!header->m_dataOffset)
+    {
+        m_actContainer = nullptr;
+    }
+    else if (!m_actContainer ||
+             !m_actContainer->SetFromRaw(buffer, reply->size, header->m_dataOffset))
+    {
+        m_actContainer =
+            OpenGymDataContainer::CreateFromRaw(buffer, reply->size, header->m_dataOffset);
+        NS_ABORT_MSG_IF(!m_actContainer, "Malformed raw action message");
+    }
+    SetHold(header->m_holdSteps, header->m_holdTime);
+    return header->m_stopSimReq;
+}
+
+bool
+OpenGymInterface::IsHolding() const
+{
+    // the states of agents are sent at every notification
+    return !m_simEnd && m_agentStatesCb.IsNull() &&
+           (m_holdSteps > 0 || Simulator::Now() < m_holdUntil);
+}
+
+void
+OpenGymInterface::SetHold(uint32_t steps, double seconds)
+{
+    m_holdSteps = steps;
+    m_holdUntil = seconds > 0 ? Simulator::Now() + Seconds(seconds) : Time(0);
+}
+
+bool
+OpenGymInterface::IsTriggered(Ptr<OpenGymDataContainer> obs)
+{
+    if (!m_useTrigger || m_simEnd || !m_agentStatesCb.IsNull())
+    {
+        return true;
+    }
+    m_triggerValues.clear();
+    if (obs)
+    {
+        obs->AppendValues(m_triggerValues);
+    }
+    return CheckTrigger();
+}
+
+bool
+OpenGymInterface::CheckTrigger()
+{
+    // the first observation, or one of another shape, is always sent
+    bool triggered = m_triggerValues.size() != m_sentValues.size();
+    if (!triggered && m_trigger.maxsilence() > 0)
+    {
+        triggered = Simulator::Now() >= m_sentTime + Seconds(m_trigger.maxsilence());
+    }
+    int thresholds = m_trigger.thresholds_size();
+    // a single threshold applies to every element, otherwise there is one per element
+    NS_ABORT_MSG_IF(thresholds > 1 && m_triggerValues.size() != std::size_t(thresholds),
+                    "Trigger has " << thresholds << " thresholds for an observation of "
+                                   << m_triggerValues.size() << " elements");
+    for (std::size_t i = 0; !triggered && i < m_triggerValues.size(); ++i)
+    {
+        double change = std::abs(m_triggerValues[i] - m_sentValues[i]);
+        double threshold = 0;
+        if (thresholds == 1)
+        {
+            threshold = m_trigger.thresholds(0);
+        }
+        else if (thresholds > 1)
+        {
+            threshold = m_trigger.thresholds(i);
+        }
+        triggered = (threshold > 0 && change >= threshold) ||
+                    (m_trigger.maxchange() > 0 && change >= m_trigger.maxchange());
+    }
+    if (triggered)
+    {
+        m_sentValues.swap(m_triggerValues);
+        m_sentTime = Simulator::Now();
+    }
+    return triggered;
+}
+
+void
+OpenGymInterface::SkipNotification(float reward)
+{
+    if (m_holdSteps > 0)
+    {
+        --m_holdSteps;
+    }
+    m_heldReward += reward;
+}
+
+void
+OpenGymInterface::ReleasePooledContainers()
+{
+    // Tuples and Dicts are usually pooled after their elements, so going
+    // backwards frees most elements in a single pass
+    for (auto it = m_containerPool.rbegin(); it != m_containerPool.rend(); ++it)
+    {
+        if ((*it)->GetReferenceCount() == 1)
+        {
+            (*it)->Clear();
+        }
+    }
+}
+
+void
+OpenGymInterface::StopSimulation()
+{
+    NS_LOG_DEBUG("---Stop requested");
+    m_stopEnvRequested = true;
+    Simulator::Stop();
+    if (m_episodeLoop)
+    {
+        // Simulator::Run returns, and RunEpisodes waits for the next episode
+        return;
+    }
+    Simulator::Destroy();
+    std::exit(0);
 }
 
 void
@@ -227,6 +767,192 @@ OpenGymInterface::WaitForStop()
     NotifyCurrentState();
 }
 
+void
+OpenGymInterface::ReceiveEpisodeRequest(ns3_ai_gym::EpisodeRequest& request)
+{
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface = GetMsgInterface();
+    // the previous episode has received its stop request before Python side sends this
+    msgInterface->CppRecvBegin();
+    const Ns3AiGymMsg* reply = msgInterface->GetPy2CppStruct();
+    bool parsed = request.ParseFromArray(reply->buffer.get(), reply->size);
+    msgInterface->CppRecvEnd();
+    NS_ABORT_MSG_IF(!parsed, "Failed to parse the episode request");
+    if (request.stop())
+    {
+        m_episodeLoop = false;
+        StopSimulation();
+    }
+}
+
+void
+OpenGymInterface::SetEpisodeRun(const ns3_ai_gym::EpisodeRequest& request, uint64_t defaultRun)
+{
+    if (request.seed())
+    {
+        RngSeedManager::SetSeed(request.seed());
+    }
+    RngSeedManager::SetRun(request.has_run() ? request.run() : defaultRun);
+    NS_LOG_DEBUG("Episode seed " << RngSeedManager::GetSeed() << " run "
+                                 << RngSeedManager::GetRun());
+}
+
+void
+OpenGymInterface::ForkEpisodes()
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(m_initSimMsgSent, "Episodes must be forked before the first notification");
+    m_episodeServer = true;
+    // the handshake is done once, the children inherit its outcome
+    Init();
+
+    uint64_t initialRun = RngSeedManager::GetRun();
+    ns3_ai_gym::EpisodeRequest request;
+    for (uint64_t episode = 0;; ++episode)
+    {
+        ReceiveEpisodeRequest(request);
+
+        // otherwise every child would write the output buffered so far again
+        std::cout.flush();
+        std::fflush(stdout);
+        pid_t pid = fork();
+        NS_ABORT_MSG_IF(pid < 0, "Failed to fork episode " << episode);
+        if (pid == 0)
+        {
+            SetEpisodeRun(request, initialRun + episode);
+            return;
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        NS_LOG_DEBUG("Episode " << episode << " exited with status " << status);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::ostringstream info;
+            info << "Episode " << episode;
+            if (WIFSIGNALED(status))
+            {
+                info << " was killed by signal " << WTERMSIG(status);
+            }
+            else
+            {
+                info << " exited with status " << WEXITSTATUS(status);
+            }
+            NS_LOG_WARN(info.str());
+            NotifyEpisodeFailure(info.str());
+        }
+    }
+}
+
+void
+OpenGymInterface::NotifyEpisodeFailure(const std::string& info)
+{
+    NS_LOG_FUNCTION(this << info);
+    // a child that dies while writing a state leaves no room for this one, and is not recovered
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface = GetMsgInterface();
+    m_episodeFailed = true;
+    msgInterface->CppSendBegin();
+    Ns3AiGymMsg* request = msgInterface->GetCpp2PyStruct();
+    if (m_wireFormat == ns3_ai_gym::RAW)
+    {
+        WriteRawState(request, nullptr, 0, true, info);
+    }
+    else if (m_wireFormat == ns3_ai_gym::FLAT)
+    {
+        WriteFlatState(request, nullptr, 0, true, info);
+    }
+    else
+    {
+        WriteProtobufState(request, nullptr, 0, true, info);
+    }
+    msgInterface->CppSendEnd();
+    m_episodeFailed = false;
+
+    // the stop request of the game over, which is all there is to read
+    msgInterface->CppRecvBegin();
+    msgInterface->CppRecvEnd();
+}
+
+void
+OpenGymInterface::DescribeSpaces(ns3_ai_gym::SimInitMsg& msg)
+{
+    Ptr<OpenGymSpace> obsSpace = GetObservationSpace();
+    Ptr<OpenGymSpace> actionSpace = GetActionSpace();
+    if (obsSpace)
+    {
+        msg.mutable_obsspace()->CopyFrom(obsSpace->GetSpaceDescription());
+    }
+    if (actionSpace)
+    {
+        msg.mutable_actspace()->CopyFrom(actionSpace->GetSpaceDescription());
+    }
+}
+
+ns3_ai_gym::EnvStateMsg::Reason
+OpenGymInterface::GetStateReason(bool isGameOver) const
+{
+    if (m_episodeFailed)
+    {
+        return ns3_ai_gym::EnvStateMsg::EpisodeFailed;
+    }
+    return isGameOver && !m_simEnd ? ns3_ai_gym::EnvStateMsg::GameOver
+                                   : ns3_ai_gym::EnvStateMsg::SimulationEnd;
+}
+
+void
+OpenGymInterface::RunEpisodes(Callback<void, const EpisodeParams&> scenario)
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(m_initSimMsgSent, "Episodes must be run before the first notification");
+    m_episodeServer = true;
+    // the spaces come from the environment of a scenario with default parameters
+    uint64_t initialRun = RngSeedManager::GetRun();
+    scenario(EpisodeParams());
+    Init();
+    m_episodeLoop = true;
+    ns3_ai_gym::SimInitMsg spaces;
+    DescribeSpaces(spaces);
+    std::string initSpaces = spaces.SerializeAsString();
+
+    ns3_ai_gym::EpisodeRequest request;
+    for (uint64_t episode = 0;; ++episode)
+    {
+        ReceiveEpisodeRequest(request);
+        // the scenario built for the spaces is run as is if nothing differs
+        bool built = episode == 0 && !request.seed() && !request.has_run() &&
+                     request.params().empty();
+        SetEpisodeRun(request, initialRun + episode);
+        if (!built)
+        {
+            Simulator::Destroy();
+            scenario(EpisodeParams(request.params().begin(), request.params().end()));
+            // Python side keeps the spaces and flat schema sent at init
+            spaces.Clear();
+            DescribeSpaces(spaces);
+            NS_ABORT_MSG_IF(spaces.SerializeAsString() != initSpaces,
+                            "Spaces of episode "
+                                << episode << " differ from the ones sent at init, the scenario "
+                                << "must build the same spaces for every parameter");
+        }
+
+        m_simEnd = false;
+        m_stopEnvRequested = false;
+        SetHold(0, 0);
+        m_heldReward = 0;
+        m_sentValues.clear();
+        m_flatSent.clear();
+        if (m_normalizer)
+        {
+            m_normalizer->ResetReturn();
+        }
+        Simulator::Run();
+        if (!m_stopEnvRequested)
+        {
+            // out of events, Python side gets the last state and stops the episode
+            NotifySimulationEnd();
+        }
+        NS_LOG_DEBUG("Episode " << episode << " is over");
+    }
+}
+
 void
 OpenGymInterface::NotifySimulationEnd()
 {
@@ -238,6 +964,12 @@ OpenGymInterface::NotifySimulationEnd()
     }
 }
 
+ns3_ai_gym::WireFormat
+OpenGymInterface::GetWireFormat() const
+{
+    return m_wireFormat;
+}
+
 Ptr<OpenGymSpace>
 OpenGymInterface::GetActionSpace()
 {
@@ -364,6 +1096,12 @@ OpenGymInterface::SetExecuteActionsCb(Callback<bool, Ptr<OpenGymDataContainer>>
     m_actionCb = cb;
 }
 
+void
+OpenGymInterface::SetGetAgentStatesCb(Callback<const std::vector<OpenGymAgentState>*> cb)
+{
+    m_agentStatesCb = cb;
+}
+
 void
 OpenGymInterface::DoInitialize()
 {
@@ -374,6 +1112,8 @@ void
 OpenGymInterface::DoDispose()
 {
     NS_LOG_FUNCTION(this);
+    m_actContainer = nullptr;
+    m_containerPool.clear();
 }
 
 void
@@ -23,19 +23,31 @@
 #define NS3_NS3_AI_GYM_INTERFACE_H
 
 #include "../ns3-ai-gym-msg.h"
+#include "container.h"
+#include "messages.pb.h"
+#include "ns3-ai-gym-normalizer.h"
 
 #include <ns3/ai-module.h>
 #include <ns3/callback.h>
+#include <ns3/nstime.h>
 #include <ns3/object.h>
 #include <ns3/ptr.h>
 #include <ns3/type-id.h>
 
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+
 namespace ns3
 {
 
 class OpenGymSpace;
 class OpenGymDataContainer;
 class OpenGymEnv;
+struct OpenGymAgentState;
+template <typename S>
+struct OpenGymSchema;
 
 class OpenGymInterface : public Object
 {
@@ -47,9 +59,61 @@ class OpenGymInterface : public Object
 
     void Init();
     void NotifyCurrentState();
+
+    /**
+     * Sends a state whose observation is a struct and receives the
+     * action into a struct, both described by an OpenGymSchema, see
+     * OpenGymTypedEnv. Raw wire format only. Returns false if Python
+     * side sent no action, in which case act is left unchanged.
+     */
+    template <typename Obs, typename Act>
+    bool NotifyCurrentState(const Obs& obs,
+                            float reward,
+                            bool isGameOver,
+                            const std::string& extraInfo,
+                            Act& act);
+
     void WaitForStop();
     void NotifySimulationEnd();
 
+    /**
+     * Turns this process into a fork server, to be called once the
+     * scenario is built and before Simulator::Run. For every episode
+     * that Python side starts, a child process is forked and returns
+     * from this call with the seed and run of the episode set in
+     * RngSeedManager, while this process waits for the child to exit
+     * and never returns. Random variables created before have their
+     * streams derived from the initial run, so call AssignStreams
+     * after this call for them to differ between episodes. If a child
+     * exits before its episode is over, Python side gets a game over
+     * whose reason is EpisodeFailed.
+     */
+    void ForkEpisodes();
+
+    /**
+     * Parameters of an episode, from the reset options of Python side
+     */
+    typedef std::map<std::string, std::string> EpisodeParams;
+
+    /**
+     * Runs every episode that Python side starts in this process,
+     * instead of a process per episode. The scenario callback builds
+     * the topology, applications and the environment from the given
+     * parameters. It is called once with no parameters to get the
+     * spaces, then before each episode with its parameters, and with
+     * the seed and run of the episode set in RngSeedManager as in
+     * ForkEpisodes. Each episode is run with Simulator::Run, until
+     * Python side stops it or there are no events left, and destroyed
+     * with Simulator::Destroy before the next one. The spaces must
+     * be the same for every parameter, or this aborts. Never returns.
+     */
+    void RunEpisodes(Callback<void, const EpisodeParams&> scenario);
+
+    /**
+     * Gets the wire format negotiated at init, protobuf before
+     */
+    ns3_ai_gym::WireFormat GetWireFormat() const;
+
     Ptr<OpenGymSpace> GetActionSpace();
     Ptr<OpenGymSpace> GetObservationSpace();
     Ptr<OpenGymDataContainer> GetObservation();
@@ -65,9 +129,25 @@ class OpenGymInterface : public Object
     void SetGetGameOverCb(Callback<bool> cb);
     void SetGetExtraInfoCb(Callback<std::string> cb);
     void SetExecuteActionsCb(Callback<bool, Ptr<OpenGymDataContainer>> cb);
+    /**
+     * Sets the callback of a multi-agent environment that gets the
+     * states of the agents sent with the observation, see
+     * OpenGymMultiAgentEnv
+     */
+    void SetGetAgentStatesCb(Callback<const std::vector<OpenGymAgentState>*> cb);
 
     void Notify(Ptr<OpenGymEnv> entity);
 
+    /**
+     * Gets an empty container of type C to be filled and returned by
+     * GetObservation, instead of creating one at every step. A pooled
+     * container is handed out again once nothing but the pool refers
+     * to it, that is once the step that sent it is over, so its memory
+     * (and the ns-3 object construction) is reused across steps.
+     */
+    template <typename C>
+    Ptr<C> GetPooledContainer();
+
   protected:
     // Inherited
     void DoInitialize() override;
@@ -76,10 +156,96 @@ class OpenGymInterface : public Object
   private:
     static Ptr<OpenGymInterface>* DoGet();
     //    static void Delete();
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* GetMsgInterface();
+
+    // write a state and read an action (into m_actContainer) in each wire format
+    void WriteProtobufState(Ns3AiGymMsg* request,
+                            Ptr<OpenGymDataContainer> obsDataContainer,
+                            float reward,
+                            bool isGameOver,
+                            const std::string& extraInfo);
+    bool ReadProtobufAction(const Ns3AiGymMsg* reply);
+    void WriteRawState(Ns3AiGymMsg* request,
+                       Ptr<OpenGymDataContainer> obsDataContainer,
+                       float reward,
+                       bool isGameOver,
+                       const std::string& extraInfo);
+    bool ReadRawAction(const Ns3AiGymMsg* reply);
+    // the flat format sends actions as raw messages
+    void WriteFlatState(Ns3AiGymMsg* request,
+                        Ptr<OpenGymDataContainer> obsDataContainer,
+                        float reward,
+                        bool isGameOver,
+                        const std::string& extraInfo);
+    // writes m_flatCurrent as a keyframe or as its changes from m_flatSent, which it then
+    // replaces, and returns the bytes written
+    uint64_t WriteFlatDelta(uint8_t* data);
+    // writes the raw header and the extra info following it
+    void WriteRawHeader(uint8_t* buffer,
+                        float reward,
+                        bool isGameOver,
+                        const std::string& extraInfo,
+                        uint64_t dataOffset);
+    void StopSimulation();
+    // sets the descriptions of the observation and action spaces, if any
+    void DescribeSpaces(ns3_ai_gym::SimInitMsg& msg);
+    // reason of a state sent to Python side
+    ns3_ai_gym::EnvStateMsg::Reason GetStateReason(bool isGameOver) const;
+    // ends the episode of a child that failed with a game over, which Python side is waiting for
+    // and answers with a stop request
+    void NotifyEpisodeFailure(const std::string& info);
+
+    // receives the request of the next episode, and stops if it asks to
+    void ReceiveEpisodeRequest(ns3_ai_gym::EpisodeRequest& request);
+    // sets the seed and run of an episode in RngSeedManager
+    void SetEpisodeRun(const ns3_ai_gym::EpisodeRequest& request, uint64_t defaultRun);
+
+    // clears the pooled containers of the last step, so that their elements are released
+    void ReleasePooledContainers();
+
+    // whether the last action is still held, see EnvActMsg
+    bool IsHolding() const;
+    // holds the action just received for the given notifications and simulation time
+    void SetHold(uint32_t steps, double seconds);
+    // counts a notification skipped while holding, whose reward is sent with the next one
+    void SkipNotification(float reward);
+    // whether an observation is sent according to the trigger, always true without one
+    bool IsTriggered(Ptr<OpenGymDataContainer> obs);
+    // compares m_triggerValues to the last values sent, which they replace if triggered
+    bool CheckTrigger();
 
     bool m_simEnd;
     bool m_stopEnvRequested;
     bool m_initSimMsgSent;
+    bool m_episodeServer; //!< whether episodes are started by requests
+    bool m_episodeLoop;   //!< whether episodes run in this process, see RunEpisodes
+    bool m_episodeFailed; //!< whether the state sent ends a failed episode, see ForkEpisodes
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* m_msgInterface;
+    ns3_ai_gym::WireFormat m_wireFormat;         //!< negotiated at init
+    std::vector<Ns3AiGymFlatField> m_flatSchema; //!< of observations, compiled at init
+    uint64_t m_flatSize;                         //!< bytes of an observation in the flat format
+    bool m_flatDelta;                            //!< whether flat observations are sent as changes
+    std::vector<uint8_t> m_flatCurrent;          //!< observation to send, with m_flatDelta
+    std::vector<uint8_t> m_flatSent;             //!< last observation sent, empty before a keyframe
+    std::vector<uint32_t> m_flatChanged;         //!< words changed since m_flatSent
+
+    google::protobuf::Arena m_arena;          //!< owns the messages reused across steps
+    ns3_ai_gym::EnvStateMsg* m_envStateMsg;   //!< state sent at every step
+    ns3_ai_gym::EnvActMsg* m_envActMsg;       //!< action received at every step
+    Ptr<OpenGymDataContainer> m_actContainer; //!< updated in place if the action keeps its shape
+    std::vector<Ptr<OpenGymDataContainer>> m_containerPool; //!< see GetPooledContainer
+    uint32_t m_holdSteps; //!< notifications left to skip, see EnvActMsg
+    Time m_holdUntil;     //!< notifications before this are skipped
+    float m_heldReward;   //!< reward of the skipped notifications
+    bool m_heldReceived;  //!< whether the held action had data, for typed environments
+
+    bool m_useTrigger;                   //!< whether notifications are filtered by m_trigger
+    ns3_ai_gym::TriggerConfig m_trigger; //!< set by Python side at init
+    std::vector<double> m_triggerValues; //!< elements of the observation to send
+    std::vector<double> m_sentValues;    //!< elements of the last observation sent
+    Time m_sentTime;                     //!< time of the last observation sent
+
+    std::unique_ptr<OpenGymNormalizer> m_normalizer; //!< set by Python side at init
 
     Callback<Ptr<OpenGymSpace>> m_actionSpaceCb;
     Callback<Ptr<OpenGymSpace>> m_observationSpaceCb;
@@ -88,8 +254,161 @@ class OpenGymInterface : public Object
     Callback<float> m_rewardCb;
     Callback<std::string> m_extraInfoCb;
     Callback<bool, Ptr<OpenGymDataContainer>> m_actionCb;
+    Callback<const std::vector<OpenGymAgentState>*> m_agentStatesCb;
 };
 
+template <typename Obs, typename Act>
+bool
+OpenGymInterface::NotifyCurrentState(const Obs& obs,
+                                     float reward,
+                                     bool isGameOver,
+                                     const std::string& extraInfo,
+                                     Act& act)
+{
+    NS_ABORT_MSG_IF(m_wireFormat == ns3_ai_gym::PROTOBUF,
+                    "Structs are only sent with the raw and flat wire formats");
+    if (m_stopEnvRequested)
+    {
+        return false;
+    }
+    // act is left as the held action, which the caller applies again
+    if (IsHolding() && !isGameOver)
+    {
+        SkipNotification(reward);
+        return m_heldReceived;
+    }
+    if (m_useTrigger && !isGameOver)
+    {
+        const auto* elements =
+            reinterpret_cast<const typename OpenGymSchema<Obs>::ElementType*>(&obs);
+        m_triggerValues.assign(elements, elements + OpenGymSchema<Obs>::count);
+        if (!CheckTrigger())
+        {
+            SkipNotification(reward);
+            return m_heldReceived;
+        }
+    }
+    reward += m_heldReward;
+    m_heldReward = 0;
+    if (m_normalizer)
+    {
+        reward = m_normalizer->ScaleReward(reward, isGameOver);
+    }
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface = GetMsgInterface();
+
+    // send the observation as a single Box node, or as the only field of the flat format
+    msgInterface->CppSendBegin();
+    Ns3AiGymMsg* request = msgInterface->GetCpp2PyStruct();
+    uint64_t dataOffset = sizeof(Ns3AiGymRawHeader) + Ns3AiGymRawAlign(extraInfo.size());
+    bool flat = m_wireFormat == ns3_ai_gym::FLAT;
+    bool delta = flat && m_flatDelta;
+    uint64_t payload = flat ? dataOffset : dataOffset + sizeof(Ns3AiGymRawNode);
+    uint64_t size = payload + Ns3AiGymRawAlign(sizeof(Obs));
+    if (delta)
+    {
+        // a keyframe, the largest message
+        size += sizeof(Ns3AiGymDeltaHeader);
+    }
+    NS_ABORT_MSG_IF(size > request->capacity,
+                    "State message of " << size << " bytes exceeds the buffer of "
+                                        << request->capacity << " bytes, increase shmSize");
+    uint8_t* buffer = request->buffer.get();
+    WriteRawHeader(buffer, reward, isGameOver, extraInfo, dataOffset);
+    Ns3AiGymRawNode node = {};
+    node.m_type = ns3_ai_gym::Box;
+    node.m_format = OpenGymSchema<Obs>::format;
+    node.m_itemSize = sizeof(typename OpenGymSchema<Obs>::ElementType);
+    node.m_rank = 1;
+    node.m_shape[0] = OpenGymSchema<Obs>::count;
+    node.m_count = OpenGymSchema<Obs>::count;
+    node.m_size = size - dataOffset;
+    if (!flat)
+    {
+        std::memcpy(buffer + dataOffset, &node, sizeof(Ns3AiGymRawNode));
+    }
+    uint8_t* data = buffer + payload;
+    if (delta)
+    {
+        m_flatCurrent.resize(Ns3AiGymRawAlign(sizeof(Obs)));
+        data = m_flatCurrent.data();
+    }
+    std::memcpy(data, &obs, sizeof(Obs));
+    // normalized in the message, obs is left as it is. Integer elements are sent as they are,
+    // like integer Boxes of containers
+    using ElementType = typename OpenGymSchema<Obs>::ElementType;
+    if constexpr (std::is_floating_point<ElementType>::value)
+    {
+        if (m_normalizer)
+        {
+            m_normalizer->NormalizeObservation(reinterpret_cast<ElementType*>(data),
+                                               OpenGymSchema<Obs>::count);
+        }
+    }
+    if (delta)
+    {
+        size = payload + WriteFlatDelta(buffer + payload);
+    }
+    request->size = size;
+    msgInterface->CppSendEnd();
+
+    // receive the action, which must match its schema
+    msgInterface->CppRecvBegin();
+    const Ns3AiGymMsg* reply = msgInterface->GetPy2CppStruct();
+    NS_ABORT_MSG_IF(reply->size < sizeof(Ns3AiGymRawHeader), "Truncated raw action message");
+    const Ns3AiGymRawHeader* header =
+        reinterpret_cast<const Ns3AiGymRawHeader*>(reply->buffer.get());
+    bool stopSim = header->m_stopSimReq;
+    bool received = header->m_dataOffset != 0;
+    SetHold(header->m_holdSteps, header->m_holdTime);
+    m_heldReceived = received;
+    if (received)
+    {
+        uint64_t actPayload =
+            Ns3AiGymRawCheckedPayload(reply->buffer.get(),
+                                      reply->size,
+                                      header->m_dataOffset,
+                                      sizeof(typename OpenGymSchema<Act>::ElementType));
+        NS_ABORT_MSG_IF(!actPayload, "Malformed raw action message");
+        const Ns3AiGymRawNode* actNode =
+            reinterpret_cast<const Ns3AiGymRawNode*>(reply->buffer.get() + header->m_dataOffset);
+        NS_ABORT_MSG_IF(actNode->m_type != ns3_ai_gym::Box ||
+                            actNode->m_format != OpenGymSchema<Act>::format ||
+                            actNode->m_count != OpenGymSchema<Act>::count,
+                        "Action does not match its schema");
+        std::memcpy(&act, reply->buffer.get() + actPayload, sizeof(Act));
+    }
+    msgInterface->CppRecvEnd();
+
+    if (stopSim)
+    {
+        StopSimulation();
+    }
+    return received;
+}
+
+template <typename C>
+Ptr<C>
+OpenGymInterface::GetPooledContainer()
+{
+    for (const Ptr<OpenGymDataContainer>& pooled : m_containerPool)
+    {
+        if (pooled->GetReferenceCount() != 1)
+        {
+            continue;
+        }
+        Ptr<C> container = DynamicCast<C>(pooled);
+        if (container)
+        {
+            // also releases the pooled elements of a Tuple or Dict
+            container->Clear();
+            return container;
+        }
+    }
+    Ptr<C> container = CreateObject<C>();
+    m_containerPool.push_back(container);
+    return container;
+}
+
 } // end of namespace ns3
 
 #endif // NS3_NS3_AI_GYM_INTERFACE_H
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "ns3-ai-gym-multi-agent-env.h"
+
+#include "container.h"
+#include "ns3-ai-gym-interface.h"
+#include "spaces.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+
+namespace ns3
+{
+
+NS_OBJECT_ENSURE_REGISTERED(OpenGymMultiAgentEnv);
+NS_LOG_COMPONENT_DEFINE("OpenGymMultiAgentEnv");
+
+OpenGymMultiAgentEnv::OpenGymMultiAgentEnv()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+OpenGymMultiAgentEnv::~OpenGymMultiAgentEnv()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+TypeId
+OpenGymMultiAgentEnv::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::OpenGymMultiAgentEnv")
+                            .SetParent<OpenGymEnv>()
+                            .SetGroupName("OpenGym");
+    return tid;
+}
+
+void
+OpenGymMultiAgentEnv::AddAgent(const std::string& name, Ptr<OpenGymEnv> agent)
+{
+    NS_LOG_FUNCTION(this << name);
+    NS_ABORT_MSG_IF(m_indices.count(name), "Agent " << name << " is already registered");
+    m_indices[name] = m_agents.size();
+    m_names.push_back(name);
+    m_agents.push_back(agent);
+    m_isReady.push_back(false);
+}
+
+void
+OpenGymMultiAgentEnv::SetAgentReady(const std::string& name)
+{
+    NS_LOG_FUNCTION(this << name);
+    auto it = m_indices.find(name);
+    NS_ABORT_MSG_IF(it == m_indices.end(), "Agent " << name << " is not registered");
+    if (!m_isReady[it->second])
+    {
+        m_isReady[it->second] = true;
+        m_ready.push_back(it->second);
+    }
+}
+
+void
+OpenGymMultiAgentEnv::SetOpenGymInterface(Ptr<OpenGymInterface> openGymInterface)
+{
+    NS_LOG_FUNCTION(this);
+    OpenGymEnv::SetOpenGymInterface(openGymInterface);
+    openGymInterface->SetGetAgentStatesCb(
+        MakeCallback(&OpenGymMultiAgentEnv::GetAgentStates, this));
+}
+
+void
+OpenGymMultiAgentEnv::Notify()
+{
+    NS_LOG_FUNCTION(this);
+    OpenGymEnv::Notify();
+    for (std::size_t i : m_ready)
+    {
+        m_isReady[i] = false;
+    }
+    m_ready.clear();
+}
+
+Ptr<OpenGymSpace>
+OpenGymMultiAgentEnv::GetActionSpace()
+{
+    Ptr<OpenGymDictSpace> space = CreateObject<OpenGymDictSpace>();
+    for (std::size_t i = 0; i < m_agents.size(); ++i)
+    {
+        space->Add(m_names[i], m_agents[i]->GetActionSpace());
+    }
+    return space;
+}
+
+Ptr<OpenGymSpace>
+OpenGymMultiAgentEnv::GetObservationSpace()
+{
+    Ptr<OpenGymDictSpace> space = CreateObject<OpenGymDictSpace>();
+    for (std::size_t i = 0; i < m_agents.size(); ++i)
+    {
+        space->Add(m_names[i], m_agents[i]->GetObservationSpace());
+    }
+    return space;
+}
+
+bool
+OpenGymMultiAgentEnv::GetGameOver()
+{
+    // the episode is over when every agent's is
+    for (const Ptr<OpenGymEnv>& agent : m_agents)
+    {
+        if (!agent->GetGameOver())
+        {
+            return false;
+        }
+    }
+    return !m_agents.empty();
+}
+
+Ptr<OpenGymDataContainer>
+OpenGymMultiAgentEnv::GetObservation()
+{
+    // called first in a step, so the states of the ready agents are collected here
+    Ptr<OpenGymDictContainer> obs = m_openGymInterface->GetPooledContainer<OpenGymDictContainer>();
+    m_agentStates.resize(m_ready.size());
+    for (std::size_t j = 0; j < m_ready.size(); ++j)
+    {
+        Ptr<OpenGymEnv> agent = m_agents[m_ready[j]];
+        OpenGymAgentState& state = m_agentStates[j];
+        state.m_name = m_names[m_ready[j]];
+        obs->Add(state.m_name, agent->GetObservation());
+        state.m_reward = agent->GetReward();
+        state.m_isGameOver = agent->GetGameOver();
+        state.m_info = agent->GetExtraInfo();
+    }
+    return obs;
+}
+
+float
+OpenGymMultiAgentEnv::GetReward()
+{
+    float reward = 0;
+    for (const OpenGymAgentState& state : m_agentStates)
+    {
+        reward += state.m_reward;
+    }
+    return reward;
+}
+
+std::string
+OpenGymMultiAgentEnv::GetExtraInfo()
+{
+    return "";
+}
+
+bool
+OpenGymMultiAgentEnv::ExecuteActions(Ptr<OpenGymDataContainer> action)
+{
+    Ptr<OpenGymDictContainer> actions = DynamicCast<OpenGymDictContainer>(action);
+    if (!actions)
+    {
+        return false;
+    }
+    // agents without an action keep their current behavior
+    bool executed = true;
+    for (std::size_t i : m_ready)
+    {
+        Ptr<OpenGymDataContainer> agentAction = actions->Get(m_names[i]);
+        if (agentAction)
+        {
+            executed = m_agents[i]->ExecuteActions(agentAction) && executed;
+        }
+    }
+    return executed;
+}
+
+const std::vector<OpenGymAgentState>*
+OpenGymMultiAgentEnv::GetAgentStates()
+{
+    return &m_agentStates;
+}
+
+void
+OpenGymMultiAgentEnv::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    m_agents.clear();
+    OpenGymEnv::DoDispose();
+}
+
+} // namespace ns3
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3_AI_GYM_MULTI_AGENT_ENV_H
+#define NS3_AI_GYM_MULTI_AGENT_ENV_H
+
+#include "ns3-ai-gym-env.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Reward, game over and extra info of an agent, sent along
+ * its observation by OpenGymMultiAgentEnv
+ */
+struct OpenGymAgentState
+{
+    std::string m_name;
+    float m_reward;
+    bool m_isGameOver;
+    std::string m_info;
+};
+
+/**
+ * \brief Environment made of several agents, such as the rate managers
+ * of all STAs, that share one crossing to Python side per step.
+ *
+ * Each agent is an OpenGymEnv with its own spaces and callbacks, and
+ * is not connected to the interface itself. Agents that have something
+ * to decide are marked ready, and Notify sends the observations of all
+ * ready agents in one message, then hands each of them its action.
+ * The observation and action spaces are Dicts keyed by agent name,
+ * which Python side presents with the PettingZoo parallel API.
+ */
+class OpenGymMultiAgentEnv : public OpenGymEnv
+{
+  public:
+    OpenGymMultiAgentEnv();
+    ~OpenGymMultiAgentEnv() override;
+
+    static TypeId GetTypeId();
+
+    /**
+     * Registers an agent, before the first Notify
+     */
+    void AddAgent(const std::string& name, Ptr<OpenGymEnv> agent);
+
+    /**
+     * Marks an agent as ready, so that it is part of the next Notify
+     */
+    void SetAgentReady(const std::string& name);
+
+    void SetOpenGymInterface(Ptr<OpenGymInterface> openGymInterface) override;
+
+    /**
+     * Notify Python side about the states of the ready agents, and
+     * execute their actions. No agent is ready afterwards.
+     */
+    void Notify() override;
+
+    Ptr<OpenGymSpace> GetActionSpace() override;
+    Ptr<OpenGymSpace> GetObservationSpace() override;
+    bool GetGameOver() override;
+    Ptr<OpenGymDataContainer> GetObservation() override;
+    float GetReward() override;
+    std::string GetExtraInfo() override;
+    bool ExecuteActions(Ptr<OpenGymDataContainer> action) override;
+
+  protected:
+    // Inherited
+    void DoDispose() override;
+
+  private:
+    /**
+     * Gets the states of the ready agents, filled by GetObservation
+     */
+    const std::vector<OpenGymAgentState>* GetAgentStates();
+
+    std::vector<std::string> m_names;             //!< in registration order
+    std::vector<Ptr<OpenGymEnv>> m_agents;        //!< in registration order
+    std::map<std::string, std::size_t> m_indices; //!< index of each agent by name
+    std::vector<bool> m_isReady;                  //!< whether each agent is ready
+    std::vector<std::size_t> m_ready;             //!< indices of the ready agents
+    std::vector<OpenGymAgentState> m_agentStates; //!< one per ready agent
+};
+
+} // end of namespace ns3
+
+#endif // NS3_AI_GYM_MULTI_AGENT_ENV_H
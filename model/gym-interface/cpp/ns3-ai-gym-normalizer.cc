@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#include "ns3-ai-gym-normalizer.h"
+
+#include "container.h"
+
+#include <ns3/log.h>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("OpenGymNormalizer");
+
+OpenGymNormalizer::OpenGymNormalizer(const ns3_ai_gym::NormalizationConfig& config,
+                                     Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface)
+    : m_observations(config.observations()),
+      m_rewards(config.rewards()),
+      m_update(!config.freeze()),
+      m_clip(config.clip()),
+      m_rewardClip(config.rewardclip()),
+      m_gamma(config.gamma()),
+      m_epsilon(config.epsilon()),
+      m_msgInterface(msgInterface),
+      m_size(0),
+      m_index(0),
+      m_obsMean(nullptr),
+      m_obsVar(nullptr),
+      m_obsCount(nullptr),
+      m_retMean(nullptr),
+      m_retVar(nullptr),
+      m_retCount(nullptr),
+      m_return(0)
+{
+    if (m_rewards)
+    {
+        m_retMean = AddColumn("gym.ret.mean", 0);
+        m_retVar = AddColumn("gym.ret.var", 0);
+        m_retCount = AddColumn("gym.ret.count", 0);
+    }
+}
+
+void
+OpenGymNormalizer::NormalizeObservation(Ptr<OpenGymDataContainer> obs)
+{
+    if (!m_observations || !obs)
+    {
+        return;
+    }
+    if (!m_obsMean)
+    {
+        std::vector<double> values;
+        obs->AppendValues(values);
+        DeclareObservation(values.size());
+    }
+    BeginObservation();
+    obs->Normalize(*this);
+}
+
+void
+OpenGymNormalizer::NormalizeRawObservation(uint8_t* buffer, uint64_t offset)
+{
+    if (!m_observations)
+    {
+        return;
+    }
+    if (!m_obsMean)
+    {
+        DeclareObservation(VisitRaw(buffer, offset, false));
+    }
+    BeginObservation();
+    VisitRaw(buffer, offset, true);
+}
+
+void
+OpenGymNormalizer::NormalizeFlatObservation(uint8_t* data,
+                                            const std::vector<Ns3AiGymFlatField>& schema)
+{
+    if (!m_observations)
+    {
+        return;
+    }
+    if (!m_obsMean)
+    {
+        std::size_t size = 0;
+        for (const Ns3AiGymFlatField& field : schema)
+        {
+            size += field.m_count;
+        }
+        DeclareObservation(size);
+    }
+    BeginObservation();
+    for (const Ns3AiGymFlatField& field : schema)
+    {
+        if (field.m_format == Ns3AiColumnFormat<float>::value)
+        {
+            Normalize(reinterpret_cast<float*>(data + field.m_offset), field.m_count);
+        }
+        else if (field.m_format == Ns3AiColumnFormat<double>::value)
+        {
+            Normalize(reinterpret_cast<double*>(data + field.m_offset), field.m_count);
+        }
+        else
+        {
+            Skip(field.m_count);
+        }
+    }
+}
+
+float
+OpenGymNormalizer::ScaleReward(float reward, bool isGameOver)
+{
+    if (!m_rewards)
+    {
+        return reward;
+    }
+    m_return = m_return * m_gamma + reward;
+    if (m_update)
+    {
+        double n = ++*m_retCount;
+        double delta = m_return - *m_retMean;
+        *m_retMean += delta / n;
+        *m_retVar += (delta * (m_return - *m_retMean) - *m_retVar) / n;
+    }
+    double scaled = reward / std::sqrt(*m_retVar + m_epsilon);
+    if (m_rewardClip > 0)
+    {
+        scaled = std::clamp(scaled, -m_rewardClip, m_rewardClip);
+    }
+    if (isGameOver)
+    {
+        ResetReturn();
+    }
+    return scaled;
+}
+
+void
+OpenGymNormalizer::ResetReturn()
+{
+    m_return = 0;
+}
+
+void
+OpenGymNormalizer::Skip(std::size_t count)
+{
+    m_index += count;
+}
+
+void
+OpenGymNormalizer::DeclareObservation(std::size_t size)
+{
+    NS_LOG_FUNCTION(this << size);
+    // a column declared again, by another process of the same segment, must keep its shape
+    m_size = size;
+    m_obsMean = AddColumn("gym.obs.mean", size);
+    m_obsVar = AddColumn("gym.obs.var", size);
+    m_obsCount = AddColumn("gym.obs.count", 0);
+}
+
+double*
+OpenGymNormalizer::AddColumn(const std::string& name, std::size_t size)
+{
+    std::vector<uint32_t> shape;
+    if (size)
+    {
+        shape.push_back(size);
+    }
+    try
+    {
+        return m_msgInterface->AddColumn<double>(name, shape);
+    }
+    catch (const boost::interprocess::bad_alloc&)
+    {
+        NS_ABORT_MSG("No room in the segment for " << size << " elements of " << name
+                                                   << ", increase normalize maxElements");
+    }
+    catch (const std::invalid_argument& e)
+    {
+        // such as statistics restored for another observation space
+        NS_ABORT_MSG(e.what());
+    }
+    return nullptr;
+}
+
+void
+OpenGymNormalizer::BeginObservation()
+{
+    m_index = 0;
+    if (m_update)
+    {
+        ++*m_obsCount;
+    }
+}
+
+std::size_t
+OpenGymNormalizer::VisitRaw(uint8_t* buffer, uint64_t offset, bool normalize)
+{
+    const Ns3AiGymRawNode* node = reinterpret_cast<const Ns3AiGymRawNode*>(buffer + offset);
+    uint8_t* payload = buffer + Ns3AiGymRawPayload(buffer, offset);
+    if (node->m_type == ns3_ai_gym::Tuple || node->m_type == ns3_ai_gym::Dict)
+    {
+        // Dict elements are written sorted by name, as containers visit them
+        const uint64_t* children = reinterpret_cast<const uint64_t*>(payload);
+        std::size_t count = 0;
+        for (uint64_t i = 0; i < node->m_count; ++i)
+        {
+            count += VisitRaw(buffer, children[i], normalize);
+        }
+        return count;
+    }
+    if (!normalize)
+    {
+        return node->m_count;
+    }
+    if (node->m_type == ns3_ai_gym::Box && node->m_format == Ns3AiColumnFormat<float>::value)
+    {
+        Normalize(reinterpret_cast<float*>(payload), node->m_count);
+    }
+    else if (node->m_type == ns3_ai_gym::Box &&
+             node->m_format == Ns3AiColumnFormat<double>::value)
+    {
+        Normalize(reinterpret_cast<double*>(payload), node->m_count);
+    }
+    else
+    {
+        Skip(node->m_count);
+    }
+    return node->m_count;
+}
+
+} // namespace ns3
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3_AI_GYM_NORMALIZER_H
+#define NS3_AI_GYM_NORMALIZER_H
+
+#include "../ns3-ai-gym-msg.h"
+#include "../ns3-ai-gym-raw.h"
+#include "messages.pb.h"
+
+#include <ns3/abort.h>
+#include <ns3/ai-module.h>
+#include <ns3/ptr.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+class OpenGymDataContainer;
+
+/**
+ * \brief Normalizes observations and scales rewards before they are
+ * sent, as configured by Python side at init.
+ *
+ * Observation elements are normalized by their running mean and
+ * variance, and rewards by the running variance of the discounted
+ * return. The statistics are updated with Welford's algorithm and kept
+ * in columns of the segment: "gym.obs.mean", "gym.obs.var" and
+ * "gym.obs.count" for observations, "gym.ret.mean", "gym.ret.var" and
+ * "gym.ret.count" for returns. They outlive episodes, whether they run
+ * in new processes, forked ones or the same one, and Python side reads
+ * and restores them there.
+ */
+class OpenGymNormalizer
+{
+  public:
+    OpenGymNormalizer(const ns3_ai_gym::NormalizationConfig& config,
+                      Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* msgInterface);
+
+    /**
+     * Normalizes the floating-point Boxes of an observation in place.
+     * Elements are numbered as by OpenGymDataContainer::AppendValues,
+     * and every observation must have as many as the first one.
+     */
+    void NormalizeObservation(Ptr<OpenGymDataContainer> obs);
+
+    /**
+     * Normalizes an observation made of count elements in place
+     */
+    template <typename T>
+    void NormalizeObservation(T* data, std::size_t count);
+
+    /**
+     * Normalizes an observation written as raw nodes from the given
+     * offset of buffer, numbered like its container
+     */
+    void NormalizeRawObservation(uint8_t* buffer, uint64_t offset);
+
+    /**
+     * Normalizes an observation written to data in the flat format of
+     * schema
+     */
+    void NormalizeFlatObservation(uint8_t* data, const std::vector<Ns3AiGymFlatField>& schema);
+
+    /**
+     * Scales the reward of a step, and updates the discounted return,
+     * which restarts after a game over
+     */
+    float ScaleReward(float reward, bool isGameOver);
+
+    /**
+     * Restarts the discounted return, at the beginning of an episode
+     */
+    void ResetReturn();
+
+    /**
+     * Normalizes the next count elements of the observation, called by
+     * containers
+     */
+    template <typename T>
+    void Normalize(T* data, std::size_t count);
+
+    /**
+     * Leaves the next count elements of the observation as they are,
+     * called by containers
+     */
+    void Skip(std::size_t count);
+
+  private:
+    // finds or declares the columns of the observation statistics
+    void DeclareObservation(std::size_t size);
+    // counts a new observation, whose elements are numbered from 0
+    void BeginObservation();
+    // normalizes the elements of a raw node and its children if normalize, and returns how many
+    // there are
+    std::size_t VisitRaw(uint8_t* buffer, uint64_t offset, bool normalize);
+    // finds or declares a column of size elements, a scalar if 0, in the room kept for the
+    // statistics by Python side
+    double* AddColumn(const std::string& name, std::size_t size);
+
+    bool m_observations; //!< whether observations are normalized
+    bool m_rewards;      //!< whether rewards are scaled
+    bool m_update;       //!< whether the statistics are updated
+    double m_clip;       //!< bound of normalized elements, 0 for none
+    double m_rewardClip; //!< bound of scaled rewards, 0 for none
+    double m_gamma;      //!< discount factor of the return
+    double m_epsilon;    //!< added to variances
+    Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>* m_msgInterface;
+
+    std::size_t m_size;  //!< number of elements of an observation
+    std::size_t m_index; //!< number of the next element to normalize
+    double* m_obsMean;   //!< one per element, in the segment
+    double* m_obsVar;    //!< one per element, in the segment
+    double* m_obsCount;  //!< number of observations, in the segment
+    double* m_retMean;   //!< in the segment
+    double* m_retVar;    //!< in the segment
+    double* m_retCount;  //!< number of steps, in the segment
+    double m_return;     //!< discounted return of the episode
+};
+
+template <typename T>
+void
+OpenGymNormalizer::NormalizeObservation(T* data, std::size_t count)
+{
+    if (!m_observations)
+    {
+        return;
+    }
+    if (!m_obsMean)
+    {
+        DeclareObservation(count);
+    }
+    BeginObservation();
+    Normalize(data, count);
+}
+
+template <typename T>
+void
+OpenGymNormalizer::Normalize(T* data, std::size_t count)
+{
+    NS_ABORT_MSG_IF(m_index + count > m_size,
+                    "Observation has more elements than the first one, " << m_size);
+    double* mean = m_obsMean + m_index;
+    double* var = m_obsVar + m_index;
+    double n = *m_obsCount;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        double x = data[i];
+        if (m_update)
+        {
+            double delta = x - mean[i];
+            mean[i] += delta / n;
+            var[i] += (delta * (x - mean[i]) - var[i]) / n;
+        }
+        double y = (x - mean[i]) / std::sqrt(var[i] + m_epsilon);
+        if (m_clip > 0)
+        {
+            y = std::clamp(y, -m_clip, m_clip);
+        }
+        data[i] = static_cast<T>(y);
+    }
+    m_index += count;
+}
+
+} // namespace ns3
+
+#endif // NS3_AI_GYM_NORMALIZER_H
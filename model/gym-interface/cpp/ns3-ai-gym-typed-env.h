@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3_AI_GYM_TYPED_ENV_H
+#define NS3_AI_GYM_TYPED_ENV_H
+
+#include "container.h"
+#include "ns3-ai-gym-env.h"
+#include "ns3-ai-gym-interface.h"
+#include "spaces.h"
+
+#include <ns3/type-name.h>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace ns3
+{
+
+/**
+ * \brief Compile-time schema of an observation or action struct, sent
+ * as a Box of ElementType with one dimension. By default it is read
+ * from the struct, which declares
+ *
+ *     typedef uint32_t ElementType;
+ *     static constexpr float low = 0;
+ *     static constexpr float high = 10;
+ *
+ * and whose fields are all of ElementType (or arrays of it).
+ * Specialize it for structs that cannot be changed.
+ */
+template <typename S>
+struct OpenGymSchema
+{
+    typedef typename S::ElementType ElementType;
+
+    static_assert(std::is_trivially_copyable<S>::value && std::is_standard_layout<S>::value,
+                  "Struct must be copyable as raw memory");
+    static_assert(sizeof(S) % sizeof(ElementType) == 0,
+                  "Struct must only contain fields of its ElementType");
+
+    static constexpr uint32_t count = sizeof(S) / sizeof(ElementType);
+    static constexpr char format = Ns3AiColumnFormat<ElementType>::value;
+
+    static Ptr<OpenGymSpace> GetSpace()
+    {
+        std::vector<uint32_t> shape = {count};
+        return CreateObject<OpenGymBoxSpace>(S::low, S::high, shape, TypeNameGet<ElementType>());
+    };
+
+    static void ToContainer(const S& s, Ptr<OpenGymBoxContainer<ElementType>> box)
+    {
+        box->SetShape({count});
+        box->SetData(reinterpret_cast<const ElementType*>(&s), count);
+    };
+
+    static bool FromContainer(Ptr<OpenGymDataContainer> container, S& s)
+    {
+        Ptr<OpenGymBoxContainer<ElementType>> box =
+            DynamicCast<OpenGymBoxContainer<ElementType>>(container);
+        if (!box || box->GetData().size() != count)
+        {
+            return false;
+        }
+        if constexpr (std::is_same<ElementType, bool>::value)
+        {
+            // std::vector<bool> is packed
+            std::copy(box->GetData().begin(), box->GetData().end(), reinterpret_cast<bool*>(&s));
+        }
+        else
+        {
+            std::memcpy(&s, box->GetData().data(), sizeof(S));
+        }
+        return true;
+    };
+};
+
+/**
+ * \brief Gym environment whose observation and action are structs with
+ * a fixed schema, see OpenGymSchema. Env derives from it (CRTP) and
+ * defines, without virtual:
+ *
+ *     void FillObservation(Obs& obs);
+ *     void ApplyActions(const Act& act);
+ *
+ * along with GetReward, GetGameOver and GetExtraInfo. Spaces are
+ * generated from the schemas. With the raw wire format, Notify copies
+ * the structs to and from the shared memory segment, without
+ * containers, protobuf or type switches. With protobuf, it falls back
+ * to containers built from the structs. Declare Env final so that the
+ * calls through it are not virtual either.
+ */
+template <typename Env, typename Obs, typename Act>
+class OpenGymTypedEnv : public OpenGymEnv
+{
+  public:
+    typedef Obs ObsType;
+    typedef Act ActType;
+
+    Ptr<OpenGymSpace> GetObservationSpace() final;
+    Ptr<OpenGymSpace> GetActionSpace() final;
+    Ptr<OpenGymDataContainer> GetObservation() final;
+    bool ExecuteActions(Ptr<OpenGymDataContainer> action) final;
+
+    /**
+     * Notify Python side about the state, and apply the action
+     */
+    void Notify() override;
+
+  protected:
+    Obs m_obs{}; //!< filled by Env at every step
+    Act m_act{}; //!< received at every step, kept when there is no action
+};
+
+template <typename Env, typename Obs, typename Act>
+Ptr<OpenGymSpace>
+OpenGymTypedEnv<Env, Obs, Act>::GetObservationSpace()
+{
+    return OpenGymSchema<Obs>::GetSpace();
+}
+
+template <typename Env, typename Obs, typename Act>
+Ptr<OpenGymSpace>
+OpenGymTypedEnv<Env, Obs, Act>::GetActionSpace()
+{
+    return OpenGymSchema<Act>::GetSpace();
+}
+
+template <typename Env, typename Obs, typename Act>
+Ptr<OpenGymDataContainer>
+OpenGymTypedEnv<Env, Obs, Act>::GetObservation()
+{
+    // protobuf and simulation end only
+    static_cast<Env*>(this)->FillObservation(m_obs);
+    Ptr<OpenGymBoxContainer<typename OpenGymSchema<Obs>::ElementType>> box =
+        m_openGymInterface->GetPooledContainer<
+            OpenGymBoxContainer<typename OpenGymSchema<Obs>::ElementType>>();
+    OpenGymSchema<Obs>::ToContainer(m_obs, box);
+    return box;
+}
+
+template <typename Env, typename Obs, typename Act>
+bool
+OpenGymTypedEnv<Env, Obs, Act>::ExecuteActions(Ptr<OpenGymDataContainer> action)
+{
+    // protobuf only
+    if (!OpenGymSchema<Act>::FromContainer(action, m_act))
+    {
+        return false;
+    }
+    static_cast<Env*>(this)->ApplyActions(m_act);
+    return true;
+}
+
+template <typename Env, typename Obs, typename Act>
+void
+OpenGymTypedEnv<Env, Obs, Act>::Notify()
+{
+    if (!m_openGymInterface)
+    {
+        return;
+    }
+    // the wire format is negotiated at init
+    m_openGymInterface->Init();
+    if (m_openGymInterface->GetWireFormat() == ns3_ai_gym::PROTOBUF)
+    {
+        m_openGymInterface->NotifyCurrentState();
+        return;
+    }
+
+    Env* env = static_cast<Env*>(this);
+    env->FillObservation(m_obs);
+    if (m_openGymInterface->NotifyCurrentState(m_obs,
+                                               env->GetReward(),
+                                               env->GetGameOver(),
+                                               env->GetExtraInfo(),
+                                               m_act))
+    {
+        env->ApplyActions(m_act);
+    }
+}
+
+} // namespace ns3
+
+#endif // NS3_AI_GYM_TYPED_ENV_H
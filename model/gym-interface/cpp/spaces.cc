@@ -24,12 +24,34 @@
 #include "ns3/log.h"
 #include "ns3/object.h"
 
+#include <map>
+
 namespace ns3
 {
 
 NS_LOG_COMPONENT_DEFINE("OpenGymSpace");
 NS_OBJECT_ENSURE_REGISTERED(OpenGymSpace);
 
+ns3_ai_gym::Dtype
+OpenGymDtypeOf(const std::string& typeName)
+{
+    static const std::map<std::string, ns3_ai_gym::Dtype> dtypes = {
+        {"int8_t", ns3_ai_gym::INT8},
+        {"int16_t", ns3_ai_gym::INT16},
+        {"int32_t", ns3_ai_gym::INT},
+        {"int64_t", ns3_ai_gym::INT64},
+        {"uint8_t", ns3_ai_gym::UINT8},
+        {"uint16_t", ns3_ai_gym::UINT16},
+        {"uint32_t", ns3_ai_gym::UINT},
+        {"uint64_t", ns3_ai_gym::UINT64},
+        {"bool", ns3_ai_gym::BOOL},
+        {"float", ns3_ai_gym::FLOAT},
+        {"double", ns3_ai_gym::DOUBLE},
+    };
+    auto it = dtypes.find(typeName);
+    return it != dtypes.end() ? it->second : ns3_ai_gym::FLOAT;
+}
+
 TypeId
 OpenGymSpace::GetTypeId()
 {
@@ -186,27 +208,7 @@ OpenGymBoxSpace::DoInitialize()
 void
 OpenGymBoxSpace::SetDtype()
 {
-    std::string name = m_dtypeName;
-    if (name == "int8_t" || name == "int16_t" || name == "int32_t" || name == "int64_t")
-    {
-        m_dtype = ns3_ai_gym::INT;
-    }
-    else if (name == "uint8_t" || name == "uint16_t" || name == "uint32_t" || name == "uint64_t")
-    {
-        m_dtype = ns3_ai_gym::UINT;
-    }
-    else if (name == "float")
-    {
-        m_dtype = ns3_ai_gym::FLOAT;
-    }
-    else if (name == "double")
-    {
-        m_dtype = ns3_ai_gym::DOUBLE;
-    }
-    else
-    {
-        m_dtype = ns3_ai_gym::FLOAT;
-    }
+    m_dtype = OpenGymDtypeOf(m_dtypeName);
 }
 
 float
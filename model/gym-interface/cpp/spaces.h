@@ -26,9 +26,17 @@
 
 #include "ns3/object.h"
 
+#include <string>
+
 namespace ns3
 {
 
+/**
+ * Gets the Box dtype of an element type named as by TypeNameGet, FLOAT
+ * for unknown types
+ */
+ns3_ai_gym::Dtype OpenGymDtypeOf(const std::string& typeName);
+
 class OpenGymSpace : public Object
 {
   public:
@@ -20,14 +20,76 @@
 #ifndef NS3_NS3_AI_GYM_MSG_H
 #define NS3_NS3_AI_GYM_MSG_H
 
+#include <cstddef>
 #include <stdint.h>
 
-#define MSG_BUFFER_SIZE 1024
+#include <boost/interprocess/offset_ptr.hpp>
 
+/**
+ * \brief Names of the columns holding the Gym message buffers
+ */
+#define NS3AI_GYM_CPP2PY_BUFFER "gym cpp2py buffer"
+#define NS3AI_GYM_PY2CPP_BUFFER "gym py2cpp buffer"
+
+/**
+ * \brief Room left in the segment for the column descriptions and
+ * the alignment of the Gym message buffers
+ */
+#define NS3AI_GYM_BUFFER_SLACK 1024
+
+/**
+ * \brief A serialized protobuf message. The buffer lives in the shared
+ * memory segment, so messages are serialized into and parsed from it
+ * in place.
+ */
 struct Ns3AiGymMsg
 {
-    uint8_t buffer[MSG_BUFFER_SIZE];
+    boost::interprocess::offset_ptr<uint8_t> buffer;
     uint32_t size;
+    uint32_t capacity;
 };
 
+namespace ns3
+{
+
+/**
+ * Splits the free memory of the segment between the buffers of every
+ * message slot of both directions, but for reserved bytes left to the
+ * columns declared later, such as the statistics of OpenGymNormalizer.
+ * Called by the memory creator (Python side) right after creating the
+ * interface, so the largest message is set by the segment size and
+ * the ring depth.
+ */
+template <typename Interface>
+void
+Ns3AiGymAllocateBuffers(Interface& interface, std::size_t reserved = 0)
+{
+    uint32_t depth = interface.GetRingDepth();
+    std::size_t free = interface.GetFreeMemory();
+    std::size_t slack = NS3AI_GYM_BUFFER_SLACK + reserved;
+    std::size_t capacity = free > slack ? (free - slack) / (2 * depth) : 0;
+    capacity = capacity < UINT32_MAX ? capacity : UINT32_MAX;
+    // keeps the slots aligned for the raw format
+    capacity -= capacity % 8;
+
+    // one column per direction, with a row per slot
+    uint8_t* cpp2py = static_cast<uint8_t*>(
+        interface.AddColumn(NS3AI_GYM_CPP2PY_BUFFER, 'B', 1, {depth, uint32_t(capacity)})
+            ->m_data.get());
+    uint8_t* py2cpp = static_cast<uint8_t*>(
+        interface.AddColumn(NS3AI_GYM_PY2CPP_BUFFER, 'B', 1, {depth, uint32_t(capacity)})
+            ->m_data.get());
+    for (uint32_t i = 0; i < depth; ++i)
+    {
+        Ns3AiGymMsg* request = interface.GetCpp2PyStructAt(i);
+        request->buffer = cpp2py + i * capacity;
+        request->capacity = capacity;
+        Ns3AiGymMsg* reply = interface.GetPy2CppStructAt(i);
+        reply->buffer = py2cpp + i * capacity;
+        reply->capacity = capacity;
+    }
+}
+
+} // namespace ns3
+
 #endif // NS3_NS3_AI_GYM_MSG_H
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3_NS3_AI_GYM_RAW_H
+#define NS3_NS3_AI_GYM_RAW_H
+
+#include "../msg-interface/ns3-ai-msg-column.h"
+
+#include <stdint.h>
+
+/*
+ * Raw wire format of Gym states and actions, an alternative to protobuf
+ * negotiated in SimInitMsg and SimInitAck. A message is a header, the
+ * extra info string, and a tree of data nodes. Each node is followed by
+ * its name (Dict elements only) and its payload:
+ * - Box: the elements in row-major order
+ * - Discrete: one uint32 element
+ * - Tuple and Dict: a table of uint64 node offsets, then the nodes
+ * Offsets are from the start of the buffer, and every part is padded to
+ * NS3AI_GYM_RAW_ALIGNMENT bytes. All numbers are little-endian, the
+ * native byte order of the platforms ns3-ai runs on.
+ *
+ * The flat format sends actions as raw messages, but observations as
+ * the header, the extra info, and the elements of every Box and
+ * Discrete of the observation at the offsets of a schema compiled from
+ * the observation space and sent once in SimInitMsg. States then carry
+ * no nodes or names, whatever the nesting of the observation.
+ *
+ * With SimInitAck.flatDelta, the observation at the data offset is a
+ * Ns3AiGymDeltaHeader followed by either a keyframe, the observation as
+ * above, or the changes from the last observation sent: the uint32
+ * indices of the 8-byte words of the observation that changed, padded,
+ * then their new values. The smaller of the two is sent, and the first
+ * observation of an episode is always a keyframe.
+ */
+
+/**
+ * \brief Maximum number of dimensions of a Box in the raw format
+ */
+#define NS3AI_GYM_RAW_MAX_RANK 4
+
+/**
+ * \brief Alignment in bytes of every part of a raw message
+ */
+#define NS3AI_GYM_RAW_ALIGNMENT 8
+
+namespace ns3
+{
+
+/**
+ * \brief Header of a raw state (C++ to Python) or action (Python to
+ * C++) message
+ */
+struct Ns3AiGymRawHeader
+{
+    float m_reward;        //!< state only
+    uint32_t m_isGameOver; //!< state only
+    uint32_t m_reason;     //!< state only, see ns3_ai_gym::EnvStateMsg::Reason
+    uint32_t m_stopSimReq; //!< action only
+    uint32_t m_infoLength; //!< length of the extra info following the header, state only
+    uint32_t m_holdSteps;  //!< action only, see ns3_ai_gym::EnvActMsg
+    uint64_t m_dataOffset; //!< offset of the root node, 0 if there is no data
+    double m_holdTime;     //!< action only, see ns3_ai_gym::EnvActMsg
+};
+
+/**
+ * \brief A data node of a raw message
+ */
+struct Ns3AiGymRawNode
+{
+    uint32_t m_type;                          //!< see ns3_ai_gym::SpaceType
+    char m_format;                            //!< element type, see Ns3AiColumnFormat
+    uint8_t m_itemSize;                       //!< element size in bytes
+    uint16_t m_nameLength;                    //!< length of the name following the node
+    uint32_t m_rank;                          //!< number of dimensions of a Box
+    uint32_t m_shape[NS3AI_GYM_RAW_MAX_RANK]; //!< size of each dimension of a Box
+    uint64_t m_count;                         //!< number of elements or child nodes
+    uint64_t m_size;                          //!< bytes of the node, its name and its payload
+};
+
+/**
+ * \brief A Box or Discrete of an observation in the flat format, see
+ * ns3_ai_gym::FlatSchema
+ */
+struct Ns3AiGymFlatField
+{
+    uint64_t m_offset; //!< from the data offset of the message
+    uint64_t m_count;  //!< number of elements
+    char m_format;     //!< element type, see Ns3AiColumnFormat
+};
+
+/**
+ * \brief Header of an observation in the flat format with
+ * SimInitAck.flatDelta
+ */
+struct Ns3AiGymDeltaHeader
+{
+    uint32_t m_keyframe; //!< whether the whole observation follows
+    uint32_t m_count;    //!< number of changed words, 0 for a keyframe
+};
+
+static_assert(sizeof(Ns3AiGymRawHeader) == 40, "Python side assumes a 40-byte raw header");
+static_assert(sizeof(Ns3AiGymRawNode) == 48, "Python side assumes a 48-byte raw node");
+static_assert(sizeof(Ns3AiGymDeltaHeader) == 8, "Python side assumes an 8-byte delta header");
+
+/**
+ * Rounds a size up to NS3AI_GYM_RAW_ALIGNMENT
+ */
+inline uint64_t
+Ns3AiGymRawAlign(uint64_t size)
+{
+    return (size + NS3AI_GYM_RAW_ALIGNMENT - 1) & ~uint64_t(NS3AI_GYM_RAW_ALIGNMENT - 1);
+}
+
+/**
+ * Gets the offset of the payload of the node at the given offset
+ */
+inline uint64_t
+Ns3AiGymRawPayload(const uint8_t* buffer, uint64_t offset)
+{
+    const Ns3AiGymRawNode* node = reinterpret_cast<const Ns3AiGymRawNode*>(buffer + offset);
+    return offset + sizeof(Ns3AiGymRawNode) + Ns3AiGymRawAlign(node->m_nameLength);
+}
+
+/**
+ * Like Ns3AiGymRawPayload, but returns 0 if the node is misaligned, or if
+ * the node, its name or m_count items of itemSize bytes end past a
+ * message of size bytes
+ */
+inline uint64_t
+Ns3AiGymRawCheckedPayload(const uint8_t* buffer, uint64_t size, uint64_t offset, uint64_t itemSize)
+{
+    if (offset % NS3AI_GYM_RAW_ALIGNMENT || offset > size ||
+        size - offset < sizeof(Ns3AiGymRawNode))
+    {
+        return 0;
+    }
+    const Ns3AiGymRawNode* node = reinterpret_cast<const Ns3AiGymRawNode*>(buffer + offset);
+    uint64_t payload = Ns3AiGymRawPayload(buffer, offset);
+    if (payload > size || (itemSize && node->m_count > (size - payload) / itemSize))
+    {
+        return 0;
+    }
+    return payload;
+}
+
+} // namespace ns3
+
+#endif // NS3_NS3_AI_GYM_RAW_H
@@ -17,46 +17,513 @@
  * Author:  Muyuan Shen <muyuan_shen@hust.edu.cn>
  */
 
+#include "../cpp/messages.pb.h"
+
 #include <ns3/ai-module.h>
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
 
 namespace py = pybind11;
 
-PYBIND11_MODULE(ns3ai_gym_msg_py, m)
+typedef ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg> GymInterface;
+
+/**
+ * NumPy array sharing memory with a column. The interface object is
+ * the array's base, so it stays alive as long as the array does.
+ */
+static py::array
+ColumnArray(py::object self, ns3::Ns3AiColumnInfo* info)
+{
+    std::vector<py::ssize_t> shape(info->m_shape, info->m_shape + info->m_rank);
+    return py::array(py::dtype(std::string(1, info->m_format)), shape, info->m_data.get(), self);
+}
+
+/**
+ * Gets the given shape, or a flat one if it does not match the number
+ * of elements
+ */
+static std::vector<py::ssize_t>
+ArrayShape(py::ssize_t size, const google::protobuf::RepeatedField<uint32_t>& shape)
+{
+    std::vector<py::ssize_t> dims(shape.begin(), shape.end());
+    py::ssize_t count = 1;
+    for (py::ssize_t dim : dims)
+    {
+        count *= dim;
+    }
+    if (dims.empty() || count != size)
+    {
+        dims.assign(1, size);
+    }
+    return dims;
+}
+
+/**
+ * Copies a repeated field into a NumPy array of the given shape, see
+ * ArrayShape
+ */
+template <typename T, typename Field>
+static py::array
+FieldToArray(const Field& field, const google::protobuf::RepeatedField<uint32_t>& shape)
+{
+    py::array_t<T> array(ArrayShape(field.size(), shape));
+    std::copy(field.begin(), field.end(), array.mutable_data());
+    return array;
+}
+
+/**
+ * Copies the packed data of a Box into a NumPy array of the given
+ * shape, see ArrayShape
+ */
+template <typename T>
+static py::array
+PackedToArray(const ns3_ai_gym::BoxDataContainer& box)
+{
+    const std::string& bytes = box.packeddata();
+    py::ssize_t size = std::is_same<T, bool>::value ? bytes.size() * 8 : bytes.size() / sizeof(T);
+    size = std::min<py::ssize_t>(size, box.packedcount());
+    py::array_t<T> array(ArrayShape(size, box.shape()));
+    T* data = array.mutable_data();
+    if constexpr (std::is_same<T, bool>::value)
+    {
+        for (py::ssize_t i = 0; i < size; ++i)
+        {
+            data[i] = (bytes[i / 8] >> (i % 8)) & 1;
+        }
+    }
+    else
+    {
+        std::memcpy(data, bytes.data(), size * sizeof(T));
+    }
+    return array;
+}
+
+/**
+ * Converts a data container into NumPy arrays (Box), ints (Discrete),
+ * tuples (Tuple) and dicts (Dict)
+ */
+static py::object
+DataContainerToPy(const ns3_ai_gym::DataContainer& dataContainer)
 {
-    m.attr("msg_buffer_size") = MSG_BUFFER_SIZE;
+    if (dataContainer.type() == ns3_ai_gym::Discrete)
+    {
+        ns3_ai_gym::DiscreteDataContainer discrete;
+        dataContainer.data().UnpackTo(&discrete);
+        return py::int_(discrete.data());
+    }
+    if (dataContainer.type() == ns3_ai_gym::Box)
+    {
+        ns3_ai_gym::BoxDataContainer box;
+        dataContainer.data().UnpackTo(&box);
+        switch (box.dtype())
+        {
+        case ns3_ai_gym::INT:
+            return FieldToArray<int32_t>(box.intdata(), box.shape());
+        case ns3_ai_gym::UINT:
+            return FieldToArray<uint32_t>(box.uintdata(), box.shape());
+        case ns3_ai_gym::DOUBLE:
+            return FieldToArray<double>(box.doubledata(), box.shape());
+        case ns3_ai_gym::INT64:
+            return FieldToArray<int64_t>(box.int64data(), box.shape());
+        case ns3_ai_gym::UINT64:
+            return FieldToArray<uint64_t>(box.uint64data(), box.shape());
+        case ns3_ai_gym::INT8:
+            return PackedToArray<int8_t>(box);
+        case ns3_ai_gym::INT16:
+            return PackedToArray<int16_t>(box);
+        case ns3_ai_gym::UINT8:
+            return PackedToArray<uint8_t>(box);
+        case ns3_ai_gym::UINT16:
+            return PackedToArray<uint16_t>(box);
+        case ns3_ai_gym::BOOL:
+            return PackedToArray<bool>(box);
+        default:
+            return FieldToArray<float>(box.floatdata(), box.shape());
+        }
+    }
+    if (dataContainer.type() == ns3_ai_gym::Tuple)
+    {
+        ns3_ai_gym::TupleDataContainer tuple;
+        dataContainer.data().UnpackTo(&tuple);
+        py::tuple result(tuple.element_size());
+        for (int i = 0; i < tuple.element_size(); ++i)
+        {
+            result[i] = DataContainerToPy(tuple.element(i));
+        }
+        return std::move(result);
+    }
+    if (dataContainer.type() == ns3_ai_gym::Dict)
+    {
+        ns3_ai_gym::DictDataContainer dict;
+        dataContainer.data().UnpackTo(&dict);
+        py::dict result;
+        for (const ns3_ai_gym::DataContainer& element : dict.element())
+        {
+            result[py::str(element.name())] = DataContainerToPy(element);
+        }
+        return std::move(result);
+    }
+    return py::none();
+}
+
+template <typename T>
+using ActionArray = py::array_t<T, py::array::c_style | py::array::forcecast>;
 
+/**
+ * Gets actions as a contiguous array of T and sets their shape
+ */
+template <typename T>
+static ActionArray<T>
+ArrayFromActions(py::handle actions, google::protobuf::RepeatedField<uint32_t>* shape)
+{
+    // converts only if the dtype or layout differs
+    auto array = ActionArray<T>::ensure(actions);
+    if (!array)
+    {
+        throw py::error_already_set();
+    }
+    shape->Clear();
+    for (py::ssize_t i = 0; i < array.ndim(); ++i)
+    {
+        shape->Add(array.shape(i));
+    }
+    if (array.ndim() == 0)
+    {
+        shape->Add(1);
+    }
+    return array;
+}
+
+template <typename T, typename Field>
+static void
+ArrayToField(py::handle actions, Field* field, google::protobuf::RepeatedField<uint32_t>* shape)
+{
+    ActionArray<T> array = ArrayFromActions<T>(actions, shape);
+    field->Resize(array.size(), 0);
+    std::memcpy(field->mutable_data(), array.data(), array.size() * sizeof(T));
+}
+
+/**
+ * Fills the packed data of a Box, see PackedToArray
+ */
+template <typename T>
+static void
+ArrayToPacked(py::handle actions, ns3_ai_gym::BoxDataContainer& box)
+{
+    ActionArray<T> array = ArrayFromActions<T>(actions, box.mutable_shape());
+    std::string* bytes = box.mutable_packeddata();
+    const T* data = array.data();
+    if constexpr (std::is_same<T, bool>::value)
+    {
+        bytes->assign((array.size() + 7) / 8, 0);
+        for (py::ssize_t i = 0; i < array.size(); ++i)
+        {
+            (*bytes)[i / 8] |= char(data[i] << (i % 8));
+        }
+    }
+    else
+    {
+        bytes->assign(reinterpret_cast<const char*>(data), array.size() * sizeof(T));
+    }
+    box.set_packedcount(array.size());
+}
+
+static bool
+IsSpace(py::handle space, const char* name)
+{
+    return py::isinstance(space, py::module_::import("gymnasium.spaces").attr(name));
+}
+
+/**
+ * Fills a data container from actions of a Gymnasium space. Box
+ * actions are sent with the space's dtype, or as float32 if it has no
+ * Dtype.
+ */
+static void
+PyToDataContainer(py::handle actions, py::handle space, ns3_ai_gym::DataContainer& dataContainer)
+{
+    if (IsSpace(space, "Discrete"))
+    {
+        ns3_ai_gym::DiscreteDataContainer discrete;
+        discrete.set_data(actions.cast<uint32_t>());
+        dataContainer.set_type(ns3_ai_gym::Discrete);
+        dataContainer.mutable_data()->PackFrom(discrete);
+    }
+    else if (IsSpace(space, "Box"))
+    {
+        ns3_ai_gym::BoxDataContainer box;
+        py::dtype dtype = py::dtype::from_args(space.attr("dtype"));
+        switch (ns3::Ns3AiColumnFormatOf(dtype.kind(), dtype.itemsize()))
+        {
+        case '?':
+            box.set_dtype(ns3_ai_gym::BOOL);
+            ArrayToPacked<bool>(actions, box);
+            break;
+        case 'b':
+            box.set_dtype(ns3_ai_gym::INT8);
+            ArrayToPacked<int8_t>(actions, box);
+            break;
+        case 'B':
+            box.set_dtype(ns3_ai_gym::UINT8);
+            ArrayToPacked<uint8_t>(actions, box);
+            break;
+        case 'h':
+            box.set_dtype(ns3_ai_gym::INT16);
+            ArrayToPacked<int16_t>(actions, box);
+            break;
+        case 'H':
+            box.set_dtype(ns3_ai_gym::UINT16);
+            ArrayToPacked<uint16_t>(actions, box);
+            break;
+        case 'i':
+            box.set_dtype(ns3_ai_gym::INT);
+            ArrayToField<int32_t>(actions, box.mutable_intdata(), box.mutable_shape());
+            break;
+        case 'I':
+            box.set_dtype(ns3_ai_gym::UINT);
+            ArrayToField<uint32_t>(actions, box.mutable_uintdata(), box.mutable_shape());
+            break;
+        case 'q':
+            box.set_dtype(ns3_ai_gym::INT64);
+            ArrayToField<int64_t>(actions, box.mutable_int64data(), box.mutable_shape());
+            break;
+        case 'Q':
+            box.set_dtype(ns3_ai_gym::UINT64);
+            ArrayToField<uint64_t>(actions, box.mutable_uint64data(), box.mutable_shape());
+            break;
+        case 'd':
+            box.set_dtype(ns3_ai_gym::DOUBLE);
+            ArrayToField<double>(actions, box.mutable_doubledata(), box.mutable_shape());
+            break;
+        default:
+            box.set_dtype(ns3_ai_gym::FLOAT);
+            ArrayToField<float>(actions, box.mutable_floatdata(), box.mutable_shape());
+        }
+        dataContainer.set_type(ns3_ai_gym::Box);
+        dataContainer.mutable_data()->PackFrom(box);
+    }
+    else if (IsSpace(space, "Tuple"))
+    {
+        ns3_ai_gym::TupleDataContainer tuple;
+        py::tuple subSpaces = space.attr("spaces");
+        py::sequence subActions = py::reinterpret_borrow<py::sequence>(actions);
+        for (std::size_t i = 0; i < subSpaces.size(); ++i)
+        {
+            py::object subAction = subActions[i];
+            py::object subSpace = subSpaces[i];
+            PyToDataContainer(subAction, subSpace, *tuple.add_element());
+        }
+        dataContainer.set_type(ns3_ai_gym::Tuple);
+        dataContainer.mutable_data()->PackFrom(tuple);
+    }
+    else if (IsSpace(space, "Dict"))
+    {
+        ns3_ai_gym::DictDataContainer dict;
+        py::object subSpaces = space.attr("spaces");
+        for (auto item : py::reinterpret_borrow<py::dict>(actions))
+        {
+            ns3_ai_gym::DataContainer* element = dict.add_element();
+            py::object subSpace = subSpaces[item.first];
+            PyToDataContainer(item.second, subSpace, *element);
+            element->set_name(item.first.cast<std::string>());
+        }
+        dataContainer.set_type(ns3_ai_gym::Dict);
+        dataContainer.mutable_data()->PackFrom(dict);
+    }
+    else
+    {
+        throw py::type_error("Unsupported action space");
+    }
+}
+
+PYBIND11_MODULE(ns3ai_gym_msg_py, m)
+{
     py::class_<Ns3AiGymMsg>(m, "Ns3AiGymMsg")
         .def(py::init<>())
         .def_readwrite("size", &Ns3AiGymMsg::size)
+        .def_readonly("capacity", &Ns3AiGymMsg::capacity)
         .def("get_buffer",
              [](Ns3AiGymMsg& msg) {
                  // Get memoryview of the buffer
-                 return py::memoryview::from_memory((void*)msg.buffer, msg.size);
+                 return py::memoryview::from_memory((void*)msg.buffer.get(), msg.size);
              })
         .def("get_buffer_full", [](Ns3AiGymMsg& msg) {
             // Get memoryview of the buffer
-            return py::memoryview::from_memory((void*)msg.buffer, MSG_BUFFER_SIZE);
+            return py::memoryview::from_memory((void*)msg.buffer.get(), msg.capacity);
         });
 
     py::class_<ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>>(m, "Ns3AiMsgInterfaceImpl")
-        .def(py::init<bool,
-                      bool,
-                      bool,
-                      uint32_t,
-                      const char*,
-                      const char*,
-                      const char*,
-                      const char*>())
+        .def(py::init([](bool is_memory_creator,
+                         bool use_vector,
+                         bool handle_finish,
+                         uint32_t size,
+                         const char* segment_name,
+                         const char* cpp2py_msg_name,
+                         const char* py2cpp_msg_name,
+                         const char* lockable_name,
+                         uint32_t wait_policy,
+                         uint32_t spin_count,
+                         uint32_t ring_depth,
+                         std::size_t reserved) {
+            auto interface =
+                new ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>(is_memory_creator,
+                                                                         use_vector,
+                                                                         handle_finish,
+                                                                         size,
+                                                                         segment_name,
+                                                                         cpp2py_msg_name,
+                                                                         py2cpp_msg_name,
+                                                                         lockable_name,
+                                                                         wait_policy,
+                                                                         spin_count,
+                                                                         ring_depth);
+            // message buffers take the rest of the segment, but for the reserved bytes
+            if (is_memory_creator)
+            {
+                ns3::Ns3AiGymAllocateBuffers(*interface, reserved);
+            }
+            return interface;
+        }),
+             py::arg("is_memory_creator"),
+             py::arg("use_vector"),
+             py::arg("handle_finish"),
+             py::arg("size"),
+             py::arg("segment_name"),
+             py::arg("cpp2py_msg_name"),
+             py::arg("py2cpp_msg_name"),
+             py::arg("lockable_name"),
+             py::arg("wait_policy"),
+             py::arg("spin_count"),
+             py::arg("ring_depth"),
+             py::arg("reserved") = 0)
         .def("PyRecvBegin", &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PyRecvBegin)
+        .def("PyTryRecvBegin",
+             &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PyTryRecvBegin)
         .def("PyRecvEnd", &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PyRecvEnd)
         .def("PySendBegin", &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PySendBegin)
         .def("PySendEnd", &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::PySendEnd)
+        .def("GetAttachCount",
+             &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::GetAttachCount)
+        .def("EnableStats",
+             &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::EnableStats,
+             py::arg("dumpAtExit") = false)
+        .def("DumpStats",
+             [](ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>& self) { self.DumpStats(); })
+        .def("GetLatencyPercentile",
+             &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::GetLatencyPercentile)
         .def("GetCpp2PyStruct",
              &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::GetCpp2PyStruct,
              py::return_value_policy::reference)
         .def("GetPy2CppStruct",
              &ns3::Ns3AiMsgInterfaceImpl<Ns3AiGymMsg, Ns3AiGymMsg>::GetPy2CppStruct,
-             py::return_value_policy::reference);
+             py::return_value_policy::reference)
+        .def("AddColumn",
+             [](py::object self,
+                const std::string& name,
+                py::object dtype,
+                const std::vector<uint32_t>& shape) {
+                 py::dtype dt = py::dtype::from_args(dtype);
+                 char format = ns3::Ns3AiColumnFormatOf(dt.kind(), dt.itemsize());
+                 if (!format)
+                 {
+                     throw py::type_error("Unsupported dtype for column " + name);
+                 }
+                 ns3::Ns3AiColumnInfo* info =
+                     self.cast<GymInterface&>().AddColumn(name, format, dt.itemsize(), shape);
+                 return ColumnArray(self, info);
+             })
+        .def("GetColumn", [](py::object self, const std::string& name) -> py::object {
+            ns3::Ns3AiColumnInfo* info = self.cast<GymInterface&>().GetColumnInfo(name);
+            if (!info)
+            {
+                return py::none();
+            }
+            return ColumnArray(self, info);
+        });
+
+    // protobuf wire format, decoded and encoded in C++ instead of with the
+    // Python protobuf runtime
+    m.def(
+        "recv_env_state",
+        [](GymInterface& interface, bool block) -> py::object {
+            static ns3_ai_gym::EnvStateMsg envStateMsg;
+            if (block)
+            {
+                interface.PyRecvBegin();
+            }
+            else if (!interface.PyTryRecvBegin())
+            {
+                return py::none();
+            }
+            const Ns3AiGymMsg* request = interface.GetCpp2PyStruct();
+            bool parsed = envStateMsg.ParseFromArray(request->buffer.get(), request->size);
+            interface.PyRecvEnd();
+            if (!parsed)
+            {
+                throw std::runtime_error("Failed to parse the state message");
+            }
+            py::list agents;
+            for (const ns3_ai_gym::AgentState& agent : envStateMsg.agents())
+            {
+                agents.append(
+                    py::make_tuple(agent.name(), agent.reward(), agent.isgameover(), agent.info()));
+            }
+            return py::make_tuple(DataContainerToPy(envStateMsg.obsdata()),
+                                  envStateMsg.reward(),
+                                  envStateMsg.isgameover(),
+                                  static_cast<int>(envStateMsg.reason()),
+                                  envStateMsg.info(),
+                                  agents);
+        },
+        py::arg("interface"),
+        py::arg("block") = true,
+        "Receives a state message and returns (obs, reward, isGameOver, reason, info, agents), "
+        "or None if not block and no message is available. agents lists (name, reward, "
+        "isGameOver, info) for multi-agent environments.");
+    m.def(
+        "send_env_act",
+        [](GymInterface& interface,
+           py::object actions,
+           py::object space,
+           bool stopSimReq,
+           uint32_t holdSteps,
+           double holdTime) {
+            static ns3_ai_gym::EnvActMsg envActMsg;
+            envActMsg.Clear();
+            envActMsg.set_stopsimreq(stopSimReq);
+            envActMsg.set_holdsteps(holdSteps);
+            envActMsg.set_holdtime(holdTime);
+            if (!actions.is_none())
+            {
+                PyToDataContainer(actions, space, *envActMsg.mutable_actdata());
+            }
+            std::size_t size = envActMsg.ByteSizeLong();
+            Ns3AiGymMsg* reply = interface.GetPy2CppStruct();
+            if (size > reply->capacity)
+            {
+                throw std::runtime_error("Message of " + std::to_string(size) +
+                                         " bytes exceeds the buffer of " +
+                                         std::to_string(reply->capacity) +
+                                         " bytes, increase shmSize");
+            }
+            interface.PySendBegin();
+            envActMsg.SerializeWithCachedSizesToArray(reply->buffer.get());
+            reply->size = size;
+            interface.PySendEnd();
+        },
+        py::arg("interface"),
+        py::arg("actions"),
+        py::arg("space"),
+        py::arg("stopSimReq") = false,
+        py::arg("holdSteps") = 0,
+        py::arg("holdTime") = 0.0,
+        "Sends an action message, with no data if actions is None. The action is held for "
+        "holdSteps notifications and holdTime seconds of simulation time.");
 }
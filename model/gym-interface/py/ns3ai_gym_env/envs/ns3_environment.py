@@ -1,14 +1,41 @@
+import struct
 import numpy as np
 import gymnasium as gym
 from gymnasium import spaces
 import messages_pb2 as pb
 import ns3ai_gym_msg_py as py_binding
-from ns3ai_utils import Experiment
+from ns3ai_utils import Experiment, DEFAULT_SPIN_COUNT
 
+# raw wire format, must match ns3-ai-gym-raw.h
+RAW_ALIGNMENT = 8
+RAW_HEADER = struct.Struct('<fIIIIIQd')
+RAW_NODE = struct.Struct('<IcBHI4I4xQQ')
+RAW_OFFSET = struct.Struct('<Q')
+RAW_DISCRETE = struct.Struct('<I')
+RAW_DELTA = struct.Struct('<II')
+# format of Box elements by NumPy kind and size, as Ns3AiColumnFormatOf
+RAW_FORMATS = {('b', 1): '?', ('i', 1): 'b', ('i', 2): 'h', ('i', 4): 'i', ('i', 8): 'q',
+               ('u', 1): 'B', ('u', 2): 'H', ('u', 4): 'I', ('u', 8): 'Q', ('f', 4): 'f',
+               ('f', 8): 'd'}
+
+WIRE_FORMATS = {'protobuf': pb.PROTOBUF, 'raw': pb.RAW, 'flat': pb.FLAT}
+
+# NumPy dtypes of Box spaces, float32 for those without a Dtype
+BOX_DTYPES = {pb.INT: np.int32, pb.UINT: np.uint32, pb.FLOAT: np.float32, pb.DOUBLE: np.float64,
+              pb.INT8: np.int8, pb.INT16: np.int16, pb.INT64: np.int64, pb.UINT8: np.uint8,
+              pb.UINT16: np.uint16, pb.UINT64: np.uint64, pb.BOOL: np.bool_}
+
+
+def _raw_align(size):
+    return (size + RAW_ALIGNMENT - 1) & ~(RAW_ALIGNMENT - 1)
+
+
+def _raw_format(dtype):
+    dtype = np.dtype(dtype)
+    return RAW_FORMATS.get((dtype.kind, dtype.itemsize), 'f')
 
-class Ns3Env(gym.Env):
-    _created = False
 
+class Ns3Env(gym.Env):
     def _create_space(self, spaceDesc):
         space = None
         if spaceDesc.type == pb.Discrete:
@@ -22,16 +49,12 @@ class Ns3Env(gym.Env):
             low = boxSpacePb.low
             high = boxSpacePb.high
             shape = tuple(boxSpacePb.shape)
-            mtype = boxSpacePb.dtype
-
-            if mtype == pb.INT:
-                mtype = np.int
-            elif mtype == pb.UINT:
-                mtype = np.uint
-            elif mtype == pb.DOUBLE:
-                mtype = np.float
-            else:
-                mtype = np.float
+            mtype = BOX_DTYPES.get(boxSpacePb.dtype, np.float32)
+            if np.issubdtype(mtype, np.integer):
+                # bounds are floats, kept within the range of the dtype
+                info = np.iinfo(mtype)
+                low = info.min if low <= info.min else int(low)
+                high = info.max if high >= info.max else int(high)
 
             space = spaces.Box(low=low, high=high, shape=shape, dtype=mtype)
 
@@ -60,114 +83,312 @@ class Ns3Env(gym.Env):
 
         return space
 
-    def _create_data(self, dataContainerPb):
-        if dataContainerPb.type == pb.Discrete:
-            discreteContainerPb = pb.DiscreteDataContainer()
-            dataContainerPb.data.Unpack(discreteContainerPb)
-            data = discreteContainerPb.data
+    # observations are views of the segment, valid until the next step
+    def _read_raw_data(self, buf, offset):
+        (nodeType, fmt, itemSize, nameLength, rank, shape0, shape1, shape2, shape3, count,
+         size) = RAW_NODE.unpack_from(buf, offset)
+        payload = offset + RAW_NODE.size + _raw_align(nameLength)
+
+        if nodeType == pb.Discrete:
+            return RAW_DISCRETE.unpack_from(buf, payload)[0]
+
+        elif nodeType == pb.Box:
+            data = np.frombuffer(buf, dtype='<' + fmt.decode(), count=count, offset=payload)
+            shape = (shape0, shape1, shape2, shape3)[:rank]
+            if rank > 1 and int(np.prod(shape)) == count:
+                data = data.reshape(shape)
+            data.flags.writeable = False
             return data
 
-        if dataContainerPb.type == pb.Box:
-            boxContainerPb = pb.BoxDataContainer()
-            dataContainerPb.data.Unpack(boxContainerPb)
-            # print(boxContainerPb.shape, boxContainerPb.dtype, boxContainerPb.uintData)
-
-            if boxContainerPb.dtype == pb.INT:
-                data = boxContainerPb.intData
-            elif boxContainerPb.dtype == pb.UINT:
-                data = boxContainerPb.uintData
-            elif boxContainerPb.dtype == pb.DOUBLE:
-                data = boxContainerPb.doubleData
-            else:
-                data = boxContainerPb.floatData
-
-            # TODO: reshape using shape info
-            data = np.array(data)
+        elif nodeType == pb.Tuple:
+            children = np.frombuffer(buf, dtype='<u8', count=count, offset=payload)
+            return tuple(self._read_raw_data(buf, int(child)) for child in children)
+
+        elif nodeType == pb.Dict:
+            children = np.frombuffer(buf, dtype='<u8', count=count, offset=payload)
+            data = {}
+            for child in children:
+                child = int(child)
+                childNameLength = RAW_NODE.unpack_from(buf, child)[3]
+                name = bytes(buf[child + RAW_NODE.size:child + RAW_NODE.size + childNameLength])
+                data[name.decode()] = self._read_raw_data(buf, child)
             return data
 
-        elif dataContainerPb.type == pb.Tuple:
-            tupleDataPb = pb.TupleDataContainer()
-            dataContainerPb.data.Unpack(tupleDataPb)
+        return None
 
-            myDataList = []
-            for pbSubData in tupleDataPb.element:
-                subData = self._create_data(pbSubData)
-                myDataList.append(subData)
+    # compiles a reader of observations in the flat format from their space description and the
+    # fields of its schema, taken in the same order. Observations are views of the segment, like
+    # with _read_raw_data, read without looking at any name or node
+    def _compile_flat(self, spaceDesc, fields):
+        if spaceDesc.type == pb.Discrete:
+            fieldOffset = next(fields).offset
+            return lambda buf, offset: RAW_DISCRETE.unpack_from(buf, offset + fieldOffset)[0]
 
-            data = tuple(myDataList)
-            return data
+        elif spaceDesc.type == pb.Box:
+            field = next(fields)
+            dtype = np.dtype(BOX_DTYPES.get(field.dtype, np.float32)).newbyteorder('<')
+            shape, count, fieldOffset = tuple(field.shape), field.count, field.offset
+
+            def readBox(buf, offset):
+                data = np.frombuffer(buf, dtype=dtype, count=count, offset=offset + fieldOffset)
+                if len(shape) > 1:
+                    data = data.reshape(shape)
+                data.flags.writeable = False
+                return data
+            return readBox
 
-        elif dataContainerPb.type == pb.Dict:
-            dictDataPb = pb.DictDataContainer()
-            dataContainerPb.data.Unpack(dictDataPb)
+        elif spaceDesc.type == pb.Tuple:
+            tupleSpacePb = pb.TupleSpace()
+            spaceDesc.space.Unpack(tupleSpacePb)
+            readers = [self._compile_flat(element, fields) for element in tupleSpacePb.element]
+            return lambda buf, offset: tuple(reader(buf, offset) for reader in readers)
 
-            myDataDict = {}
-            for pbSubData in dictDataPb.element:
-                subData = self._create_data(pbSubData)
-                myDataDict[pbSubData.name] = subData
+        elif spaceDesc.type == pb.Dict:
+            dictSpacePb = pb.DictSpace()
+            spaceDesc.space.Unpack(dictSpacePb)
+            readers = [(element.name, self._compile_flat(element, fields))
+                       for element in dictSpacePb.element]
+            return lambda buf, offset: {name: reader(buf, offset) for name, reader in readers}
 
-            data = myDataDict
-            return data
+        return lambda buf, offset: None
+
+    def _raw_size(self, actions, spaceDesc):
+        spaceType = spaceDesc.__class__
+        if spaceType == spaces.Discrete:
+            return RAW_NODE.size + _raw_align(RAW_DISCRETE.size)
+        elif spaceType == spaces.Box:
+            itemSize = np.dtype(_raw_format(spaceDesc.dtype)).itemsize
+            return RAW_NODE.size + _raw_align(np.size(actions) * itemSize)
+        elif spaceType == spaces.Tuple:
+            return RAW_NODE.size + len(spaceDesc.spaces) * RAW_OFFSET.size + sum(
+                self._raw_size(subAction, subSpace)
+                for subAction, subSpace in zip(actions, spaceDesc.spaces))
+        elif spaceType == spaces.Dict:
+            return RAW_NODE.size + len(actions) * RAW_OFFSET.size + sum(
+                _raw_align(len(sName.encode())) + self._raw_size(subAction, spaceDesc.spaces[sName])
+                for sName, subAction in actions.items())
+        raise Exception('Error: Unsupported action space {}'.format(spaceDesc))
 
-    def initialize_env(self):
+    # writes a node at offset and returns the offset after it, see ns3-ai-gym-raw.h
+    def _write_raw_data(self, buf, offset, actions, spaceDesc, name=b''):
+        spaceType = spaceDesc.__class__
+        payload = offset + RAW_NODE.size + _raw_align(len(name))
+        buf[offset + RAW_NODE.size:offset + RAW_NODE.size + len(name)] = name
+        shape = (0, 0, 0, 0)
+        rank = 0
+
+        if spaceType == spaces.Discrete:
+            nodeType, fmt, itemSize, count = pb.Discrete, b'I', RAW_DISCRETE.size, 1
+            RAW_DISCRETE.pack_into(buf, payload, int(actions))
+            end = payload + _raw_align(RAW_DISCRETE.size)
+
+        elif spaceType == spaces.Box:
+            # with the space's dtype, as with protobuf
+            fmt = _raw_format(spaceDesc.dtype).encode()
+            data = np.asarray(actions, dtype='<' + fmt.decode())
+            nodeType, itemSize, count = pb.Box, data.itemsize, data.size
+            rank = data.ndim
+            shape = (data.shape + (0, 0, 0, 0))[:4]
+            np.frombuffer(buf, dtype=data.dtype, count=count, offset=payload)[:] = data.ravel()
+            end = payload + _raw_align(data.nbytes)
+
+        else:
+            if spaceType == spaces.Tuple:
+                nodeType = pb.Tuple
+                elements = [(b'', subAction, subSpace)
+                            for subAction, subSpace in zip(actions, spaceDesc.spaces)]
+            else:
+                nodeType = pb.Dict
+                elements = [(sName.encode(), subAction, spaceDesc.spaces[sName])
+                            for sName, subAction in actions.items()]
+            fmt, itemSize, count = b'\0', 0, len(elements)
+            end = payload + count * RAW_OFFSET.size
+            for i, (subName, subAction, subSpace) in enumerate(elements):
+                RAW_OFFSET.pack_into(buf, payload + i * RAW_OFFSET.size, end)
+                end = self._write_raw_data(buf, end, subAction, subSpace, subName)
+
+        RAW_NODE.pack_into(buf, offset, nodeType, fmt, itemSize, len(name), rank, *shape, count,
+                           end - offset)
+        return end
+
+    def _send_raw_msg(self, actions=None, stopSimReq=False, holdSteps=0, holdTime=0.0):
+        dataOffset = RAW_HEADER.size
+        size = dataOffset
+        if actions is not None:
+            size += self._raw_size(actions, self.action_space)
+        else:
+            dataOffset = 0
+        py2cppMsg = self.msgInterface.GetPy2CppStruct()
+        if size > py2cppMsg.capacity:
+            raise Exception('Error: Message of {} bytes exceeds the buffer of {} bytes, '
+                            'increase shmSize'.format(size, py2cppMsg.capacity))
+        self.msgInterface.PySendBegin()
+        buf = py2cppMsg.get_buffer_full()
+        RAW_HEADER.pack_into(buf, 0, 0.0, 0, 0, stopSimReq, 0, holdSteps, dataOffset, holdTime)
+        if actions is not None:
+            self._write_raw_data(buf, dataOffset, actions, self.action_space)
+        py2cppMsg.size = size
+        self.msgInterface.PySendEnd()
+
+    # the buffer is sized from the segment, see Ns3AiGymAllocateBuffers
+    def _send_msg(self, msg):
+        replyMsg = msg.SerializeToString()
+        py2cppMsg = self.msgInterface.GetPy2CppStruct()
+        if len(replyMsg) > py2cppMsg.capacity:
+            raise Exception('Error: Message of {} bytes exceeds the buffer of {} bytes, '
+                            'increase shmSize'.format(len(replyMsg), py2cppMsg.capacity))
+        self.msgInterface.PySendBegin()
+        py2cppMsg.size = len(replyMsg)
+        py2cppMsg.get_buffer_full()[:len(replyMsg)] = replyMsg
+        self.msgInterface.PySendEnd()
+
+    # with block=False, returns False if the message has not arrived yet
+    def _recv_begin(self, block):
+        if block:
+            self.msgInterface.PyRecvBegin()
+            return True
+        return self.msgInterface.PyTryRecvBegin()
+
+    def initialize_env(self, block=True):
         simInitMsg = pb.SimInitMsg()
-        self.msgInterface.PyRecvBegin()
+        if not self._recv_begin(block):
+            return False
         request = self.msgInterface.GetCpp2PyStruct().get_buffer()
         simInitMsg.ParseFromString(request)
         self.msgInterface.PyRecvEnd()
 
         self.action_space = self._create_space(simInitMsg.actSpace)
         self.observation_space = self._create_space(simInitMsg.obsSpace)
+        self.multiAgent = simInitMsg.multiAgent
+        self.episodeServer = simInitMsg.episodeServer
 
         reply = pb.SimInitAck()
         reply.done = True
         reply.stopSimReq = False
-        reply_str = reply.SerializeToString()
-        assert len(reply_str) <= py_binding.msg_buffer_size
-
-        self.msgInterface.PySendBegin()
-        self.msgInterface.GetPy2CppStruct().size = len(reply_str)
-        self.msgInterface.GetPy2CppStruct().get_buffer_full()[:len(reply_str)] = reply_str
-        self.msgInterface.PySendEnd()
+        if self.wireFormat == 'flat' and pb.FLAT not in simInitMsg.wireFormats:
+            print('ns3-ai: simulation does not support the flat wire format, using raw')
+            self.wireFormat = 'raw'
+        if self.wireFormat == 'raw' and pb.RAW not in simInitMsg.wireFormats:
+            print('ns3-ai: simulation does not support the raw wire format, using protobuf')
+            self.wireFormat = 'protobuf'
+        reply.wireFormat = WIRE_FORMATS[self.wireFormat]
+        if self.wireFormat == 'flat':
+            self.flatReader = self._compile_flat(simInitMsg.obsSpace,
+                                                 iter(simInitMsg.obsSchema.fields))
+        self.flatDelta = self.delta and self.wireFormat == 'flat' and simInitMsg.flatDelta
+        if self.delta and not self.flatDelta:
+            print('ns3-ai: simulation does not support delta encoding, using full observations')
+        if self.flatDelta:
+            reply.flatDelta = True
+            self.flatObs = np.zeros(simInitMsg.obsSchema.size, dtype=np.uint8)
+            self.flatWords = self.flatObs.view('<u8')
+        if self.trigger is not None:
+            reply.trigger.SetInParent()
+            reply.trigger.thresholds.extend(
+                np.ravel(self.trigger.get('thresholds', [])).astype(float).tolist())
+            reply.trigger.maxChange = self.trigger.get('maxChange', 0)
+            reply.trigger.maxSilence = self.trigger.get('maxSilence', 0)
+        if self.normalize is not None:
+            if self.multiAgent:
+                raise Exception('Error: Normalization is not supported with multiple agents')
+            config = dict(self.NORMALIZE_DEFAULTS, **self.normalize)
+            config.pop('stats', None)
+            reply.normalization.observations = config['observations']
+            reply.normalization.rewards = config['rewards']
+            reply.normalization.clip = config['clip']
+            reply.normalization.rewardClip = config['rewardClip']
+            reply.normalization.gamma = config['gamma']
+            reply.normalization.epsilon = config['epsilon']
+            reply.normalization.freeze = config['freeze']
+        self._send_msg(reply)
         return True
 
     def send_close_command(self):
-        reply = pb.EnvActMsg()
-        reply.stopSimReq = True
+        if self.wireFormat != 'protobuf':
+            self._send_raw_msg(stopSimReq=True)
+            self.newStateRx = False
+            return True
 
-        replyMsg = reply.SerializeToString()
-        assert len(replyMsg) <= py_binding.msg_buffer_size
-        self.msgInterface.PySendBegin()
-        self.msgInterface.GetPy2CppStruct().size = len(replyMsg)
-        self.msgInterface.GetPy2CppStruct().get_buffer_full()[:len(replyMsg)] = replyMsg
-        self.msgInterface.PySendEnd()
+        py_binding.send_env_act(self.msgInterface, None, None, stopSimReq=True)
 
         self.newStateRx = False
         return True
 
-    def rx_env_state(self):
+    def rx_env_state(self, block=True):
         if self.newStateRx:
-            return
+            return True
 
-        envStateMsg = pb.EnvStateMsg()
-        self.msgInterface.PyRecvBegin()
-        request = self.msgInterface.GetCpp2PyStruct().get_buffer()
-        envStateMsg.ParseFromString(request)
+        if self.wireFormat != 'protobuf':
+            return self.rx_raw_env_state(block)
+
+        # decoded in C++ into shaped and typed NumPy arrays
+        state = py_binding.recv_env_state(self.msgInterface, block)
+        if state is None:
+            return False
+        (self.obsData, self.reward, self.gameOver, self.gameOverReason, self.extraInfo,
+         self.agentStates) = state
+
+        if self.gameOver:
+            self.send_close_command()
+
+        if not self.extraInfo:
+            self.extraInfo = {}
+
+        self.newStateRx = True
+        self._check_episode_failed()
+        return True
+
+    def rx_raw_env_state(self, block=True):
+        # the views are read after PyRecvEnd, C++ does not write again
+        # until the actions of this step are sent
+        if not self._recv_begin(block):
+            return False
+        buf = self.msgInterface.GetCpp2PyStruct().get_buffer_full()
         self.msgInterface.PyRecvEnd()
 
-        self.obsData = self._create_data(envStateMsg.obsData)
-        self.reward = envStateMsg.reward
-        self.gameOver = envStateMsg.isGameOver
-        self.gameOverReason = envStateMsg.reason
+        (self.reward, gameOver, self.gameOverReason, _, infoLength, _,
+         dataOffset, _) = RAW_HEADER.unpack_from(buf, 0)
+        if not dataOffset:
+            self.obsData = None
+        elif self.flatDelta:
+            self._apply_delta(buf, dataOffset)
+            self.obsData = self.flatReader(self.flatObs, 0)
+        elif self.wireFormat == 'flat':
+            self.obsData = self.flatReader(buf, dataOffset)
+        else:
+            self.obsData = self._read_raw_data(buf, dataOffset)
+        self.gameOver = bool(gameOver)
 
         if self.gameOver:
             self.send_close_command()
 
-        self.extraInfo = envStateMsg.info
+        self.extraInfo = bytes(buf[RAW_HEADER.size:RAW_HEADER.size + infoLength]).decode()
         if not self.extraInfo:
             self.extraInfo = {}
 
         self.newStateRx = True
+        self._check_episode_failed()
+        return True
+
+    # the process of a forked episode exited before its end, and the fork server ended it with a
+    # game over, so the environment can be reset
+    def _check_episode_failed(self):
+        if self.gameOver and self.gameOverReason == pb.EnvStateMsg.EpisodeFailed:
+            raise Exception('Error: {}'.format(self.extraInfo))
+
+    # updates self.flatObs in place from a keyframe or the changed words of an observation, see
+    # ns3-ai-gym-raw.h
+    def _apply_delta(self, buf, offset):
+        keyframe, count = RAW_DELTA.unpack_from(buf, offset)
+        offset += RAW_DELTA.size
+        if keyframe:
+            self.flatObs[:] = np.frombuffer(buf, dtype=np.uint8, count=self.flatObs.size,
+                                            offset=offset)
+        elif count:
+            indices = np.frombuffer(buf, dtype='<u4', count=count, offset=offset)
+            values = np.frombuffer(buf, dtype='<u8', count=count,
+                                   offset=offset + _raw_align(count * 4))
+            self.flatWords[indices] = values
 
     def get_obs(self):
         return self.obsData
@@ -181,86 +402,20 @@ class Ns3Env(gym.Env):
     def get_extra_info(self):
         return self.extraInfo
 
-    def _pack_data(self, actions, spaceDesc):
-        dataContainer = pb.DataContainer()
-
-        spaceType = spaceDesc.__class__
-
-        if spaceType == spaces.Discrete:
-            dataContainer.type = pb.Discrete
-            discreteContainerPb = pb.DiscreteDataContainer()
-            discreteContainerPb.data = actions
-            dataContainer.data.Pack(discreteContainerPb)
-
-        elif spaceType == spaces.Box:
-            dataContainer.type = pb.Box
-            boxContainerPb = pb.BoxDataContainer()
-            shape = [len(actions)]
-            boxContainerPb.shape.extend(shape)
-
-            if spaceDesc.dtype in ['int', 'int8', 'int16', 'int32', 'int64']:
-                boxContainerPb.dtype = pb.INT
-                boxContainerPb.intData.extend(actions)
-
-            elif spaceDesc.dtype in ['uint', 'uint8', 'uint16', 'uint32', 'uint64']:
-                boxContainerPb.dtype = pb.UINT
-                boxContainerPb.uintData.extend(actions)
-
-            elif spaceDesc.dtype in ['float', 'float32', 'float64']:
-                boxContainerPb.dtype = pb.FLOAT
-                boxContainerPb.floatData.extend(actions)
-
-            elif spaceDesc.dtype in ['double']:
-                boxContainerPb.dtype = pb.DOUBLE
-                boxContainerPb.doubleData.extend(actions)
-
-            else:
-                boxContainerPb.dtype = pb.FLOAT
-                boxContainerPb.floatData.extend(actions)
-
-            dataContainer.data.Pack(boxContainerPb)
-
-        elif spaceType == spaces.Tuple:
-            dataContainer.type = pb.Tuple
-            tupleDataPb = pb.TupleDataContainer()
-
-            spaceList = list(self.action_space.spaces)
-            subDataList = []
-            for subAction, subActSpaceType in zip(actions, spaceList):
-                subData = self._pack_data(subAction, subActSpaceType)
-                subDataList.append(subData)
-
-            tupleDataPb.element.extend(subDataList)
-            dataContainer.data.Pack(tupleDataPb)
-
-        elif spaceType == spaces.Dict:
-            dataContainer.type = pb.Dict
-            dictDataPb = pb.DictDataContainer()
-
-            subDataList = []
-            for sName, subAction in actions.items():
-                subActSpaceType = self.action_space.spaces[sName]
-                subData = self._pack_data(subAction, subActSpaceType)
-                subData.name = sName
-                subDataList.append(subData)
-
-            dictDataPb.element.extend(subDataList)
-            dataContainer.data.Pack(dictDataPb)
-
-        return dataContainer
-
-    def send_actions(self, actions):
-        reply = pb.EnvActMsg()
-
-        actionMsg = self._pack_data(actions, self.action_space)
-        reply.actData.CopyFrom(actionMsg)
-
-        replyMsg = reply.SerializeToString()
-        assert len(replyMsg) <= py_binding.msg_buffer_size
-        self.msgInterface.PySendBegin()
-        self.msgInterface.GetPy2CppStruct().size = len(replyMsg)
-        self.msgInterface.GetPy2CppStruct().get_buffer_full()[:len(replyMsg)] = replyMsg
-        self.msgInterface.PySendEnd()
+    # C++ side applies the actions again at the next holdSteps notifications and for holdTime
+    # seconds of simulation time without sending them, and sends the sum of their rewards with
+    # the next state. Both default to those given at init
+    def send_actions(self, actions, holdSteps=None, holdTime=None):
+        holdSteps = self.holdSteps if holdSteps is None else holdSteps
+        holdTime = self.holdTime if holdTime is None else holdTime
+        if self.wireFormat != 'protobuf':
+            self._send_raw_msg(actions, holdSteps=holdSteps, holdTime=holdTime)
+            self.newStateRx = False
+            return True
+
+        # encoded in C++, copying each Box once from NumPy
+        py_binding.send_env_act(self.msgInterface, actions, self.action_space,
+                                holdSteps=holdSteps, holdTime=holdTime)
         self.newStateRx = False
         return True
 
@@ -271,28 +426,133 @@ class Ns3Env(gym.Env):
         extraInfo = {"info": self.get_extra_info()}
         return obs, reward, done, False, extraInfo
 
-    def __init__(self, targetName, ns3Path, ns3Settings=None, shmSize=4096):
-        if self._created:
-            raise Exception('Error: Ns3Env is singleton')
-        self._created = True
-        self.exp = Experiment(targetName, ns3Path, py_binding, shmSize=shmSize)
+    NORMALIZE_DEFAULTS = {'observations': True, 'rewards': True, 'clip': 10.0,
+                          'rewardClip': 10.0, 'gamma': 0.99, 'epsilon': 1e-8, 'freeze': False}
+    # columns of the segment holding the running statistics, see OpenGymNormalizer
+    NORMALIZE_COLUMNS = ('gym.obs.mean', 'gym.obs.var', 'gym.obs.count',
+                         'gym.ret.mean', 'gym.ret.var', 'gym.ret.count')
+    # elements of the observation whose statistics fit in the room kept for them in the segment
+    NORMALIZE_MAX_ELEMENTS = 4096
+    # bytes of a column description and its allocation in the segment, besides its data
+    COLUMN_OVERHEAD = 256
+
+    # Several environments can run at once if they have different segment names (segName).
+    # waitPolicy and spinCount set how Python side waits for C++ side, see Experiment.
+    # With block=False, the simulation is only launched: call connect(block=False) until it
+    # returns True before using the environment. With build=False, ns3 does not build the
+    # target before running it. holdSteps and holdTime set how long each action is held, see
+    # send_actions. With a trigger, a dict of the fields of TriggerConfig in messages.proto such
+    # as {'thresholds': 0.1, 'maxSilence': 1.0}, C++ side only sends the observations that
+    # meet one of its conditions, and the others are skipped as if the action were held. With
+    # normalize, a dict of the fields of NormalizationConfig overriding NORMALIZE_DEFAULTS, C++
+    # side normalizes the observations and scales the rewards before sending them, starting from
+    # the statistics of normalize['stats'] if given (see get_normalization_stats). The statistics
+    # of up to normalize['maxElements'] observation elements (NORMALIZE_MAX_ELEMENTS by default)
+    # are kept in shmSize, besides the message buffers. With delta and
+    # the flat wire format, C++ side only sends the words of the observation that changed since
+    # the last one, or the whole observation when that is smaller, and observations are views of
+    # arrays updated in place at every step.
+    def __init__(self, targetName, ns3Path, ns3Settings=None, shmSize=1048576, waitPolicy='spin',
+                 spinCount=DEFAULT_SPIN_COUNT, enableStats=False, wireFormat='protobuf',
+                 segName='My Seg', block=True, build=True, holdSteps=0, holdTime=0.0,
+                 trigger=None, normalize=None, delta=False):
+        if wireFormat not in WIRE_FORMATS:
+            raise Exception('Error: Unknown wire format {}'.format(wireFormat))
+        # without any condition, no observation would be sent after the first one
+        if trigger is not None and not (
+                np.any(np.ravel(trigger.get('thresholds', [])).astype(float) > 0) or
+                trigger.get('maxChange', 0) > 0 or trigger.get('maxSilence', 0) > 0):
+            raise Exception('Error: Trigger sets no condition, set thresholds, maxChange or '
+                            'maxSilence')
+        self.requestedWireFormat = wireFormat
+        # the statistics are declared once the simulation runs, after the message buffers have
+        # taken the rest of the segment
+        self.normalizeElements = 0
+        reservedSize = 0
+        if normalize is not None:
+            self.normalizeElements = normalize.get('maxElements', self.NORMALIZE_MAX_ELEMENTS)
+            if normalize.get('stats') is not None:
+                self.normalizeElements = max(
+                    self.normalizeElements, np.size(normalize['stats'].get('gym.obs.mean', [])))
+            reservedSize = (8 * (2 * self.normalizeElements + 4) +
+                            len(self.NORMALIZE_COLUMNS) * self.COLUMN_OVERHEAD)
+        self.exp = Experiment(targetName, ns3Path, py_binding, shmSize=shmSize, segName=segName,
+                              waitPolicy=waitPolicy, spinCount=spinCount, enableStats=enableStats,
+                              reservedSize=reservedSize)
         self.ns3Settings = ns3Settings
-
+        self.holdSteps = holdSteps
+        self.holdTime = holdTime
+        self.trigger = trigger
+        self.normalize = normalize
+        self.delta = delta
+        if normalize is not None and normalize.get('stats') is not None:
+            self.set_normalization_stats(normalize['stats'])
+
+        self.launch(wait=block, build=build)
+        if block:
+            self.connect()
+
+    def _clear_state(self):
         self.newStateRx = False
         self.obsData = None
         self.reward = 0
         self.gameOver = False
         self.gameOverReason = None
         self.extraInfo = None
+        self.agentStates = []
 
-        self.msgInterface = self.exp.run(setting=self.ns3Settings, show_output=True)
-        self.initialize_env()
-        # get first observations
-        self.rx_env_state()
+    # runs the simulation, see connect
+    def launch(self, wait=True, build=True):
+        self.msgInterface = None
+        self.wireFormat = self.requestedWireFormat
+        self.flatDelta = False
+        self.connected = False
+        self.episodeServer = False
+        self._clear_state()
+
+        self.msgInterface = self.exp.run(setting=self.ns3Settings, show_output=True, build=build,
+                                         wait=wait)
+
+    # receives the spaces and the first observations of the launched simulation. With
+    # block=False, returns False if they have not arrived yet, and raises if the simulation
+    # exited instead
+    def connect(self, block=True):
+        if not self.connected:
+            if not self.initialize_env(block):
+                self._check_alive()
+                return False
+            self.connected = True
+            if self.episodeServer:
+                self.begin_episode()
+        if not self.rx_env_state(block):
+            self._check_alive()
+            return False
+        self.envDirty = False
+        return True
+
+    # asks an episode server (see OpenGymInterface::ForkEpisodes and RunEpisodes) to start the
+    # next episode, once the previous one is over. The seed and options['run'] set
+    # RngSeedManager in the episode, and the other options are the parameters of RunEpisodes
+    def begin_episode(self, seed=None, options=None):
+        self._clear_state()
+        request = pb.EpisodeRequest()
+        if seed is not None:
+            request.seed = seed
+        for key, value in (options or {}).items():
+            if key == 'run':
+                request.run = value
+            else:
+                request.params[key] = str(value)
+        self._send_msg(request)
         self.envDirty = False
 
-    def step(self, actions):
-        self.send_actions(actions)
+    def _check_alive(self):
+        if not self.exp.isalive():
+            raise Exception('Error: Simulation with segment {} exited before connecting'
+                            .format(self.exp.segName))
+
+    def step(self, actions, holdSteps=None, holdTime=None):
+        self.send_actions(actions, holdSteps, holdTime)
         self.rx_env_state()
         self.envDirty = True
         return self.get_state()
@@ -307,23 +567,38 @@ class Ns3Env(gym.Env):
             self.rx_env_state()
             self.send_close_command()
 
-        self.msgInterface = None
-        self.newStateRx = False
-        self.obsData = None
-        self.reward = 0
-        self.gameOver = False
-        self.gameOverReason = None
-        self.extraInfo = None
-
-        self.msgInterface = self.exp.run(show_output=True)
-        self.initialize_env()
-        # get first observations
-        self.rx_env_state()
-        self.envDirty = False
+        # an episode server starts the next episode instead of running the simulation again
+        if self.episodeServer:
+            self.begin_episode(seed, options)
+            self.rx_env_state()
+        else:
+            self.launch()
+            self.connect()
 
         obs = self.get_obs()
         return obs, {}
 
+    # copies the running statistics of the normalization, to be saved with the agent. Those not
+    # declared yet (before the first observation for observations) are left out
+    def get_normalization_stats(self):
+        stats = {}
+        for name in self.NORMALIZE_COLUMNS:
+            column = self.exp.msgInterface.GetColumn(name)
+            if column is not None:
+                stats[name] = np.array(column)
+        return stats
+
+    # restores statistics copied by get_normalization_stats, used from the next observation.
+    # They are kept in the segment, so they outlive the episodes of this environment
+    def set_normalization_stats(self, stats):
+        for name, value in stats.items():
+            value = np.asarray(value, dtype=np.float64)
+            if value.size > max(self.normalizeElements, 1):
+                raise Exception('Error: Statistics of {} elements exceed normalize maxElements {}'
+                                .format(value.size, self.normalizeElements))
+            column = self.exp.msgInterface.AddColumn(name, np.float64, list(value.shape))
+            column[...] = value
+
     def render(self, mode='human'):
         return
 
@@ -0,0 +1,56 @@
+from ns3ai_gym_env.envs.ns3_environment import Ns3Env
+
+
+class Ns3MultiAgentEnv:
+    """PettingZoo parallel API over a simulation whose agents are registered in an
+    OpenGymMultiAgentEnv. At every step, only the agents that C++ side marked ready are in the
+    returned dicts and in self.agents, and step takes the actions of those agents. All of them
+    reach C++ side in one message."""
+
+    metadata = {'name': 'ns3ai_multi_agent_v0', 'render_modes': []}
+
+    # the arguments are those of Ns3Env
+    def __init__(self, targetName, ns3Path, **kwargs):
+        self.env = Ns3Env(targetName, ns3Path, **kwargs)
+        if not self.env.multiAgent:
+            raise Exception('Error: Simulation does not use OpenGymMultiAgentEnv')
+        self.observation_spaces = dict(self.env.observation_space.spaces)
+        self.action_spaces = dict(self.env.action_space.spaces)
+        self.possible_agents = list(self.observation_spaces.keys())
+        self.agents = []
+        self.render_mode = None
+
+    def observation_space(self, agent):
+        return self.observation_spaces[agent]
+
+    def action_space(self, agent):
+        return self.action_spaces[agent]
+
+    def _get_state(self):
+        observations = self.env.get_obs() or {}
+        rewards = {}
+        terminations = {}
+        infos = {}
+        for name, reward, isGameOver, info in self.env.agentStates:
+            rewards[name] = reward
+            # every agent is done when the simulation is
+            terminations[name] = isGameOver or self.env.is_game_over()
+            infos[name] = {'info': info}
+        truncations = {name: False for name in rewards}
+        self.agents = [name for name in rewards if not terminations[name]]
+        return observations, rewards, terminations, truncations, infos
+
+    def reset(self, seed=None, options=None):
+        self.env.reset(seed=seed, options=options)
+        observations, _, _, _, infos = self._get_state()
+        return observations, infos
+
+    def step(self, actions):
+        self.env.step(actions)
+        return self._get_state()
+
+    def render(self):
+        return
+
+    def close(self):
+        self.env.close()
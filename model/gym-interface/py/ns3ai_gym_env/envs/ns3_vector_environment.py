@@ -0,0 +1,180 @@
+import copy
+import itertools
+import os
+import time
+import numpy as np
+from gymnasium.vector import AutoresetMode, VectorEnv
+from gymnasium.vector.utils import batch_space, concatenate, create_empty_array, iterate
+from ns3ai_gym_env.envs.ns3_environment import Ns3Env
+
+# states of a simulation in Ns3VecEnv
+_RUNNING = 0    # actions sent, waiting for the next state
+_CLOSING = 1    # episode over, to be run again once the process has exited
+_STARTING = 2   # running again, waiting for the spaces and first observations
+
+
+class Ns3VecEnv(VectorEnv):
+    """Runs num_envs simulations of the same target, each with its own segment, and steps them
+    concurrently. Actions are sent to all simulations before any state is awaited, then the
+    simulations are polled, so a slow one does not hold back the others. Finished simulations
+    are run again at the next step (next-step autoreset)."""
+
+    _segments = itertools.count()
+
+    # passes over the pending simulations that only yield the CPU, before each pass sleeps for
+    # POLL_INTERVAL seconds
+    POLL_SPINS = 100
+    POLL_INTERVAL = 0.0001
+
+    # ns3Settings is either a dict for all simulations or a list of one dict per simulation,
+    # the other arguments are those of Ns3Env
+    def __init__(self, num_envs, targetName, ns3Path, ns3Settings=None, **kwargs):
+        if num_envs < 1:
+            raise Exception('Error: Invalid number of environments {}'.format(num_envs))
+        if isinstance(ns3Settings, (list, tuple)):
+            if len(ns3Settings) != num_envs:
+                raise Exception('Error: Expected {} ns-3 settings, got {}'
+                                .format(num_envs, len(ns3Settings)))
+            settings = list(ns3Settings)
+        else:
+            settings = [ns3Settings] * num_envs
+
+        self.num_envs = num_envs
+        self.metadata = {'autoreset_mode': AutoresetMode.NEXT_STEP}
+        self.envs = []
+        # the first simulation builds the target and connects, then the others are all
+        # launched before any of them is waited for
+        for i in range(num_envs):
+            segName = 'ns3ai-gym-{}-{}'.format(os.getpid(), next(self._segments))
+            self.envs.append(Ns3Env(targetName, ns3Path, ns3Settings=settings[i],
+                                    segName=segName, block=(i == 0), build=(i == 0), **kwargs))
+        self._states = [_STARTING] * num_envs
+        self._states[0] = _RUNNING
+        self._autoreset = np.zeros(num_envs, dtype=np.bool_)
+        # seed and options of the next episode of each simulation, see reset
+        self._episodeArgs = [(None, None)] * num_envs
+        self._wait()
+
+        self.single_observation_space = self.envs[0].observation_space
+        self.single_action_space = self.envs[0].action_space
+        self.observation_space = batch_space(self.single_observation_space, num_envs)
+        self.action_space = batch_space(self.single_action_space, num_envs)
+        self._observations = create_empty_array(self.single_observation_space, num_envs)
+
+    # waits until every simulation has a new state. Simulations are polled in turn, so their
+    # states are received in the order they arrive
+    def _wait(self):
+        pending = [i for i in range(self.num_envs)]
+        passes = 0
+        while pending:
+            pending = [i for i in pending if not self._poll(i)]
+            if not pending:
+                break
+            passes += 1
+            if passes < self.POLL_SPINS:
+                os.sched_yield()
+            else:
+                time.sleep(self.POLL_INTERVAL)
+
+    def _poll(self, i):
+        env = self.envs[i]
+        if self._states[i] == _CLOSING:
+            if env.episodeServer:
+                # the next episode is started once the previous one is over
+                seed, options = self._episodeArgs[i]
+                env.begin_episode(seed, options)
+                self._states[i] = _RUNNING
+                return self._rx(i)
+            if env.exp.isalive():
+                return False
+            env.launch(wait=False, build=False)
+            self._states[i] = _STARTING
+        if self._states[i] == _STARTING:
+            if not env.connect(block=False):
+                return False
+            self._states[i] = _RUNNING
+            return True
+        return self._rx(i)
+
+    # receives the state of a running simulation if it has arrived, and raises if the simulation
+    # exited instead, so that step does not wait for it forever
+    def _rx(self, i):
+        env = self.envs[i]
+        if env.rx_env_state(block=False):
+            return True
+        if env.exp.isalive():
+            return False
+        # the state may have been sent right before the exit
+        if env.rx_env_state(block=False):
+            return True
+        raise Exception('Error: Simulation {} with segment {} exited during its episode'
+                        .format(i, env.exp.segName))
+
+    def _collect(self):
+        observations = [env.get_obs() for env in self.envs]
+        # raw observations are views of the segments, copied here before the next step
+        self._observations = concatenate(self.single_observation_space, observations,
+                                         self._observations)
+        infos = {}
+        for i, env in enumerate(self.envs):
+            infos = self._add_info(infos, {'info': env.get_extra_info()}, i)
+        return copy.deepcopy(self._observations), infos
+
+    def step_async(self, actions):
+        for i, (env, action) in enumerate(zip(self.envs, iterate(self.action_space, actions))):
+            if self._autoreset[i]:
+                # the action is ignored, the simulation was told to stop when its episode ended
+                self._states[i] = _CLOSING
+                self._episodeArgs[i] = (None, None)
+            else:
+                env.send_actions(action)
+
+    def step_wait(self):
+        self._wait()
+        rewards = np.zeros(self.num_envs, dtype=np.float64)
+        terminations = np.zeros(self.num_envs, dtype=np.bool_)
+        for i, env in enumerate(self.envs):
+            if self._autoreset[i]:
+                continue
+            rewards[i] = env.get_reward()
+            terminations[i] = env.is_game_over()
+            env.envDirty = True
+        self._autoreset = terminations.copy()
+        observations, infos = self._collect()
+        return observations, rewards, terminations, np.zeros(self.num_envs, dtype=np.bool_), infos
+
+    def step(self, actions):
+        self.step_async(actions)
+        return self.step_wait()
+
+    # seed is either an int, from which simulation i gets seed + i, or a list of one seed per
+    # simulation. Seeds and options are those of Ns3Env.reset for episode servers, and simulations
+    # run again from the start cannot take them
+    def reset(self, seed=None, options=None):
+        if seed is None or isinstance(seed, int):
+            seeds = [None if seed is None else seed + i for i in range(self.num_envs)]
+        else:
+            seeds = list(seed)
+            if len(seeds) != self.num_envs:
+                raise Exception('Error: Expected {} seeds, got {}'
+                                .format(self.num_envs, len(seeds)))
+        for i, env in enumerate(self.envs):
+            # simulations that have not been stepped keep their first observations, unless the
+            # next episode is set by a seed or options
+            if not env.envDirty and seeds[i] is None and options is None:
+                continue
+            if not env.episodeServer and (seeds[i] is not None or options is not None):
+                raise Exception('Error: Simulation {} is not an episode server, which reset needs '
+                                'for seeds and options'.format(i))
+            self._episodeArgs[i] = (seeds[i], options)
+            if not env.gameOver:
+                env.rx_env_state()
+                env.send_close_command()
+            self._states[i] = _CLOSING
+        self._autoreset[:] = False
+        self._wait()
+        return self._collect()
+
+    def close_extras(self, **kwargs):
+        for env in self.envs:
+            env.close()
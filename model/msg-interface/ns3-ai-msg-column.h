@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3_AI_MSG_COLUMN_H
+#define NS3_AI_MSG_COLUMN_H
+
+#include <cstdint>
+#include <boost/interprocess/offset_ptr.hpp>
+
+/**
+ * \brief Maximum number of dimensions of a column
+ */
+#define NS3AI_COLUMN_MAX_RANK 4
+
+/**
+ * \brief Alignment in bytes of column data, one cache line
+ */
+#define NS3AI_COLUMN_ALIGNMENT 64
+
+namespace ns3
+{
+
+/**
+ * \brief Element type code of a column, as a Python struct module
+ * format character (also understood by NumPy)
+ */
+template <typename T>
+struct Ns3AiColumnFormat;
+
+#define NS3AI_COLUMN_FORMAT(type, format)                                                          \
+    template <>                                                                                    \
+    struct Ns3AiColumnFormat<type>                                                                 \
+    {                                                                                              \
+        static constexpr char value = format;                                                      \
+    }
+
+NS3AI_COLUMN_FORMAT(bool, '?');
+NS3AI_COLUMN_FORMAT(int8_t, 'b');
+NS3AI_COLUMN_FORMAT(uint8_t, 'B');
+NS3AI_COLUMN_FORMAT(int16_t, 'h');
+NS3AI_COLUMN_FORMAT(uint16_t, 'H');
+NS3AI_COLUMN_FORMAT(int32_t, 'i');
+NS3AI_COLUMN_FORMAT(uint32_t, 'I');
+NS3AI_COLUMN_FORMAT(int64_t, 'q');
+NS3AI_COLUMN_FORMAT(uint64_t, 'Q');
+NS3AI_COLUMN_FORMAT(float, 'f');
+NS3AI_COLUMN_FORMAT(double, 'd');
+
+#undef NS3AI_COLUMN_FORMAT
+
+/**
+ * Gets the column format of an element type given by its NumPy kind
+ * ('b' for bool, 'i' for signed, 'u' for unsigned, 'f' for floating
+ * point) and size in bytes. Returns 0 if the type is not supported.
+ */
+inline char
+Ns3AiColumnFormatOf(char kind, uint32_t itemSize)
+{
+    switch (kind)
+    {
+    case 'b':
+        return itemSize == 1 ? '?' : 0;
+    case 'i':
+        return itemSize == 1   ? 'b'
+               : itemSize == 2 ? 'h'
+               : itemSize == 4 ? 'i'
+               : itemSize == 8 ? 'q'
+                               : 0;
+    case 'u':
+        return itemSize == 1   ? 'B'
+               : itemSize == 2 ? 'H'
+               : itemSize == 4 ? 'I'
+               : itemSize == 8 ? 'Q'
+                               : 0;
+    case 'f':
+        return itemSize == 4 ? 'f' : itemSize == 8 ? 'd' : 0;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * \brief Description of a column, a named, typed and fixed-shape
+ * array in the shared memory segment. The data is stored contiguously
+ * in row-major order and aligned to a cache line.
+ */
+struct Ns3AiColumnInfo
+{
+    char m_format;                           //!< element type, see Ns3AiColumnFormat
+    uint32_t m_itemSize;                     //!< element size in bytes
+    uint32_t m_rank;                         //!< number of dimensions, 0 for a scalar
+    uint32_t m_shape[NS3AI_COLUMN_MAX_RANK]; //!< size of each dimension
+    uint64_t m_count;                        //!< total number of elements
+    boost::interprocess::offset_ptr<void> m_data; //!< first element
+};
+
+/**
+ * \brief Placeholder message type for channels that only carry columns
+ */
+struct Ns3AiEmptyMsg
+{
+    uint8_t m_unused;
+};
+
+} // namespace ns3
+
+#endif // NS3_AI_MSG_COLUMN_H
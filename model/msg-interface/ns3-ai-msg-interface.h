@@ -20,14 +20,26 @@
 #ifndef NS3_AI_MSG_INTERFACE_H
 #define NS3_AI_MSG_INTERFACE_H
 
+#include "ns3-ai-msg-column.h"
+#include "ns3-ai-msg-stats.h"
 #include "ns3-ai-semaphore.h"
 
 #include <ns3/singleton.h>
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <typeindex>
+#include <unordered_map>
 #include <vector>
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/containers/vector.hpp>
@@ -36,20 +48,66 @@
 namespace ns3
 {
 
+/**
+ * \brief Size in bytes of a cache line
+ */
+#define NS3AI_CACHE_LINE 64
+
+/**
+ * \brief Flag of the message sent by CppSetFinished
+ */
+#define NS3AI_MSG_FINISH 0x1
+
+/**
+ * \brief Header of a message slot, written by the sender except
+ * for the receive time
+ */
+struct Ns3AiMsgHeader
+{
+    volatile uint64_t m_seq;      //!< sequence number, counting from 1 in each direction
+    volatile uint64_t m_sendTime; //!< steady clock time in ns when the message was sent
+    volatile uint64_t m_recvTime; //!< steady clock time in ns when the message was received
+    volatile uint32_t m_length;   //!< payload length in bytes
+    volatile uint32_t m_flags;    //!< e.g. NS3AI_MSG_FINISH
+};
+
+/**
+ * \brief Semaphores and sequence numbers of one direction, on a cache
+ * line of its own so that the two directions do not share one
+ */
+struct alignas(NS3AI_CACHE_LINE) Ns3AiMsgQueueSync
+{
+    volatile uint32_t m_emptyCount{1};
+    volatile uint32_t m_fullCount{0};
+    // number of sides blocked (or about to block) on the semaphore above
+    volatile uint32_t m_emptyWaiters{0};
+    volatile uint32_t m_fullWaiters{0};
+    volatile uint64_t m_sendSeq{0}; //!< sequence number of the last message sent
+    volatile uint64_t m_recvSeq{0}; //!< sequence number of the last message received
+};
+
 /**
  * \brief Structure containing semaphores used in msg interface
  */
 struct Ns3AiMsgSync
 {
-    volatile uint8_t m_cpp2pyEmptyCount{1};
-    volatile uint8_t m_cpp2pyFullCount{0};
-    volatile uint8_t m_py2cppEmptyCount{1};
-    volatile uint8_t m_py2cppFullCount{0};
-    bool m_isFinished{false};
+    Ns3AiMsgQueueSync m_cpp2py;
+    Ns3AiMsgQueueSync m_py2cpp;
+    // nonzero once either side has enabled latency histograms
+    alignas(NS3AI_CACHE_LINE) volatile uint32_t m_statsEnabled{0};
+    // number of times the segment was opened by a non-creator
+    volatile uint32_t m_attachCount{0};
 };
 
 /**
  * \brief A template class implementation of the message interface
+ *
+ * In struct-based mode, each direction can hold a ring of several
+ * messages (the ring depth, set by the memory creator). With depth 1,
+ * every message is a lock-step round trip. With depth N, the sender
+ * can enqueue up to N messages before the receiver consumes any.
+ * Vector-based mode always has depth 1. The creator throws
+ * std::invalid_argument for any other depth.
  */
 template <typename Cpp2PyMsgType, typename Py2CppMsgType>
 class Ns3AiMsgInterfaceImpl
@@ -64,24 +122,46 @@ class Ns3AiMsgInterfaceImpl
                                    const char* segment_name = "My Seg",
                                    const char* cpp2py_msg_name = "My Cpp to Python Msg",
                                    const char* py2cpp_msg_name = "My Python to Cpp Msg",
-                                   const char* lockable_name = "My Lockable")
-        : m_isCreator(is_memory_creator),
+                                   const char* lockable_name = "My Lockable",
+                                   uint32_t wait_policy = NS3AI_WAIT_SPIN,
+                                   uint32_t spin_count = NS3AI_DEFAULT_SPIN_COUNT,
+                                   uint32_t ring_depth = 1)
+        : m_ringDepth(ring_depth),
+          m_cpp2pyCursor(0),
+          m_py2cppCursor(0),
+          m_isCreator(is_memory_creator),
           m_useVector(use_vector),
           m_handleFinish(handle_finish),
           m_segName(segment_name),
-          m_isFinished(false)
+          m_waitPolicy(static_cast<Ns3AiWaitPolicy>(wait_policy)),
+          m_spinCount(spin_count),
+          m_isFinished(false),
+          m_stats(nullptr),
+          m_dumpStats(false),
+          m_writeBeginTime(0),
+          m_lastRecvTime(0)
     {
         using namespace boost::interprocess;
         if (m_isCreator)
         {
+            // checked before any segment of the same name is removed
+            if (m_useVector ? m_ringDepth != 1 : m_ringDepth < 1)
+            {
+                throw std::invalid_argument("Invalid ring depth " + std::to_string(m_ringDepth) +
+                                            (m_useVector ? ", vector-based mode has depth 1"
+                                                         : ", must be at least 1"));
+            }
             shared_memory_object::remove(m_segName.c_str());
-            static managed_shared_memory segment(create_only, m_segName.c_str(), size);
+            // room for latency histograms, which either side may enable later
+            m_segment = managed_shared_memory(create_only,
+                                              m_segName.c_str(),
+                                              size + sizeof(Ns3AiMsgStats) + 1024);
             if (m_useVector)
             {
-                static const Cpp2PyMsgAllocator alloc_env(segment.get_segment_manager());
-                static const Cpp2PyMsgAllocator alloc_act(segment.get_segment_manager());
-                m_cpp2pyVector = segment.construct<Cpp2PyMsgVector>(cpp2py_msg_name)(alloc_env);
-                m_py2cppVector = segment.construct<Py2CppMsgVector>(py2cpp_msg_name)(alloc_act);
+                const Cpp2PyMsgAllocator alloc_env(m_segment.get_segment_manager());
+                const Py2CppMsgAllocator alloc_act(m_segment.get_segment_manager());
+                m_cpp2pyVector = m_segment.construct<Cpp2PyMsgVector>(cpp2py_msg_name)(alloc_env);
+                m_py2cppVector = m_segment.construct<Py2CppMsgVector>(py2cpp_msg_name)(alloc_act);
                 m_cpp2pyStruct = nullptr;
                 m_py2CppStruct = nullptr;
             }
@@ -89,34 +169,49 @@ class Ns3AiMsgInterfaceImpl
             {
                 m_cpp2pyVector = nullptr;
                 m_py2cppVector = nullptr;
-                m_cpp2pyStruct = segment.construct<Cpp2PyMsgType>(cpp2py_msg_name)();
-                m_py2CppStruct = segment.construct<Py2CppMsgType>(py2cpp_msg_name)();
+                m_cpp2pyStruct =
+                    m_segment.construct<Cpp2PyMsgType>(cpp2py_msg_name)[m_ringDepth]();
+                m_py2CppStruct =
+                    m_segment.construct<Py2CppMsgType>(py2cpp_msg_name)[m_ringDepth]();
             }
-            m_sync = segment.construct<Ns3AiMsgSync>(lockable_name)();
+            SetSyncBlock(m_segment.construct<char>(lockable_name)[SyncBlockSize(m_ringDepth)](0));
+            new (m_sync) Ns3AiMsgSync();
+            m_sync->m_cpp2py.m_emptyCount = m_ringDepth;
+            m_sync->m_py2cpp.m_emptyCount = m_ringDepth;
         }
         else
         {
-            static managed_shared_memory segment(open_only, segment_name);
+            m_segment = managed_shared_memory(open_only, m_segName.c_str());
             if (m_useVector)
             {
-                m_cpp2pyVector = segment.find<Cpp2PyMsgVector>(cpp2py_msg_name).first;
-                m_py2cppVector = segment.find<Py2CppMsgVector>(py2cpp_msg_name).first;
+                m_ringDepth = 1;
+                m_cpp2pyVector = m_segment.find<Cpp2PyMsgVector>(cpp2py_msg_name).first;
+                m_py2cppVector = m_segment.find<Py2CppMsgVector>(py2cpp_msg_name).first;
                 m_cpp2pyStruct = nullptr;
                 m_py2CppStruct = nullptr;
             }
             else
             {
+                // the ring depth is decided by the creator
+                auto cpp2py = m_segment.find<Cpp2PyMsgType>(cpp2py_msg_name);
                 m_cpp2pyVector = nullptr;
                 m_py2cppVector = nullptr;
-                m_cpp2pyStruct = segment.find<Cpp2PyMsgType>(cpp2py_msg_name).first;
-                m_py2CppStruct = segment.find<Py2CppMsgType>(py2cpp_msg_name).first;
+                m_cpp2pyStruct = cpp2py.first;
+                m_py2CppStruct = m_segment.find<Py2CppMsgType>(py2cpp_msg_name).first;
+                m_ringDepth = cpp2py.second;
             }
-            m_sync = segment.find<Ns3AiMsgSync>(lockable_name).first;
+            SetSyncBlock(m_segment.find<char>(lockable_name).first);
+            // tells the creator that this side is up
+            Ns3AiSemaphore::atomic_add32(&m_sync->m_attachCount, 1);
         }
     };
 
     ~Ns3AiMsgInterfaceImpl()
     {
+        if (m_dumpStats)
+        {
+            DumpStats();
+        }
         if (m_isCreator)
         {
             boost::interprocess::shared_memory_object::remove(m_segName.c_str());
@@ -143,22 +238,64 @@ class Ns3AiMsgInterfaceImpl
 
     /**
      * Get the struct used in C++ to Python transmission in
-     * struct-based message interface
+     * struct-based message interface. With a ring, this is the
+     * slot currently being written (C++ side) or read (Python side).
      */
     Cpp2PyMsgType* GetCpp2PyStruct()
     {
         assert(!m_useVector);
-        return m_cpp2pyStruct;
+        return &m_cpp2pyStruct[m_cpp2pyCursor];
     };
 
     /**
      * Get the struct used in Python to C++ transmission in
-     * struct-based message interface
+     * struct-based message interface. With a ring, this is the
+     * slot currently being written (Python side) or read (C++ side).
      */
     Py2CppMsgType* GetPy2CppStruct()
     {
         assert(!m_useVector);
-        return m_py2CppStruct;
+        return &m_py2CppStruct[m_py2cppCursor];
+    };
+
+    /**
+     * Get the i-th struct of a batch started by PyRecvBeginBatch,
+     * i = 0 being the same as GetCpp2PyStruct()
+     */
+    Cpp2PyMsgType* GetCpp2PyStructAt(uint32_t i)
+    {
+        assert(!m_useVector);
+        assert(i < m_ringDepth);
+        return &m_cpp2pyStruct[(m_cpp2pyCursor + i) % m_ringDepth];
+    };
+
+    /**
+     * Get the i-th struct of the Python to C++ ring, i = 0 being the
+     * same as GetPy2CppStruct()
+     */
+    Py2CppMsgType* GetPy2CppStructAt(uint32_t i)
+    {
+        assert(!m_useVector);
+        assert(i < m_ringDepth);
+        return &m_py2CppStruct[(m_py2cppCursor + i) % m_ringDepth];
+    };
+
+    /**
+     * Get the number of times the segment was opened by a non-creator.
+     * The creator can wait for it to change after launching the other
+     * side, instead of sleeping.
+     */
+    uint32_t GetAttachCount() const
+    {
+        return Ns3AiSemaphore::atomic_read32(&m_sync->m_attachCount);
+    };
+
+    /**
+     * Get the number of message slots in each direction
+     */
+    uint32_t GetRingDepth() const
+    {
+        return m_ringDepth;
     };
 
     // use vector for passing multiple structures at once:
@@ -183,6 +320,187 @@ class Ns3AiMsgInterfaceImpl
         return m_py2cppVector;
     };
 
+    // use columns for named, typed and fixed-shape arrays:
+
+    /**
+     * Declares a column with the given element type and shape (empty
+     * for a scalar), and gets its data. Either side can declare a
+     * column first, zero-initialized; the other side's declaration must
+     * then have the same type and shape, or std::invalid_argument is
+     * thrown. Throws boost::interprocess::bad_alloc if the segment is
+     * too small.
+     */
+    template <typename T>
+    T* AddColumn(const std::string& name, const std::vector<uint32_t>& shape)
+    {
+        return static_cast<T*>(
+            AddColumn(name, Ns3AiColumnFormat<T>::value, sizeof(T), shape)->m_data.get());
+    };
+
+    /**
+     * Type-erased version of AddColumn, which gets the column's
+     * description. Used by Python bindings.
+     */
+    Ns3AiColumnInfo* AddColumn(const std::string& name,
+                               char format,
+                               uint32_t itemSize,
+                               const std::vector<uint32_t>& shape)
+    {
+        if (shape.size() > NS3AI_COLUMN_MAX_RANK)
+        {
+            throw std::invalid_argument("Column " + name + " has more than " +
+                                        std::to_string(NS3AI_COLUMN_MAX_RANK) + " dimensions");
+        }
+        const std::string key = ColumnKey(name);
+        Ns3AiColumnInfo* info = nullptr;
+        // find and construct at once, in case both sides declare the column
+        auto findOrConstruct = [&]() {
+            info = m_segment.find<Ns3AiColumnInfo>(key.c_str()).first;
+            if (info)
+            {
+                return;
+            }
+            uint64_t count = 1;
+            for (uint32_t dim : shape)
+            {
+                count *= dim;
+            }
+            std::size_t bytes = count * itemSize;
+            void* data = m_segment.allocate_aligned(bytes ? bytes : 1, NS3AI_COLUMN_ALIGNMENT);
+            std::memset(data, 0, bytes);
+            info = m_segment.construct<Ns3AiColumnInfo>(key.c_str())();
+            info->m_format = format;
+            info->m_itemSize = itemSize;
+            info->m_rank = shape.size();
+            std::copy(shape.begin(), shape.end(), info->m_shape);
+            info->m_count = count;
+            info->m_data = data;
+        };
+        m_segment.atomic_func(findOrConstruct);
+        // checked in every build, a column of another shape would be indexed past its end
+        if (info->m_format != format || info->m_itemSize != itemSize)
+        {
+            throw std::invalid_argument("Column " + name + " was declared with format " +
+                                        info->m_format + ", not " + format);
+        }
+        if (info->m_rank != shape.size() ||
+            !std::equal(shape.begin(), shape.end(), info->m_shape))
+        {
+            throw std::invalid_argument("Column " + name + " was declared with another shape");
+        }
+        return info;
+    };
+
+    /**
+     * Gets the data of a column declared by either side, or nullptr
+     * if the column does not exist yet. Throws std::invalid_argument if
+     * it has another type.
+     */
+    template <typename T>
+    T* GetColumn(const std::string& name)
+    {
+        Ns3AiColumnInfo* info = GetColumnInfo(name);
+        if (!info)
+        {
+            return nullptr;
+        }
+        if (info->m_format != Ns3AiColumnFormat<T>::value)
+        {
+            throw std::invalid_argument("Column " + name + " was declared with format " +
+                                        info->m_format + ", not " + Ns3AiColumnFormat<T>::value);
+        }
+        return static_cast<T*>(info->m_data.get());
+    };
+
+    /**
+     * Gets the description of a column declared by either side, or
+     * nullptr if the column does not exist yet. Used by Python bindings.
+     */
+    Ns3AiColumnInfo* GetColumnInfo(const std::string& name)
+    {
+        return m_segment.find<Ns3AiColumnInfo>(ColumnKey(name).c_str()).first;
+    };
+
+    /**
+     * Gets the number of bytes left in the segment for columns, not
+     * counting the room kept for latency histograms
+     */
+    std::size_t GetFreeMemory()
+    {
+        std::size_t free = m_segment.get_free_memory();
+        std::size_t reserved = 0;
+        if (!m_segment.find<Ns3AiMsgStats>(NS3AI_STATS_NAME).first)
+        {
+            reserved = sizeof(Ns3AiMsgStats) + 1024;
+        }
+        return free > reserved ? free - reserved : 0;
+    };
+
+    /**
+     * Get the header of the C++ to Python message being received
+     * (Python side), or of the i-th message of a batch
+     */
+    const Ns3AiMsgHeader* GetCpp2PyHeader(uint32_t i = 0) const
+    {
+        assert(i < m_ringDepth);
+        return &m_cpp2pyHeader[(m_cpp2pyCursor + i) % m_ringDepth];
+    };
+
+    /**
+     * Get the header of the Python to C++ message being received
+     * (C++ side)
+     */
+    const Ns3AiMsgHeader* GetPy2CppHeader() const
+    {
+        return &m_py2cppHeader[m_py2cppCursor];
+    };
+
+    // latency instrumentation:
+
+    /**
+     * Enables latency histograms of the round trip phases for both
+     * sides. If dumpAtExit, the histograms are printed when this
+     * side's interface is destroyed.
+     */
+    void EnableStats(bool dumpAtExit = false)
+    {
+        m_stats = m_segment.find_or_construct<Ns3AiMsgStats>(NS3AI_STATS_NAME)();
+        m_sync->m_statsEnabled = 1;
+        m_dumpStats = dumpAtExit;
+    };
+
+    /**
+     * Gets the latency histograms, or nullptr if they are not enabled
+     */
+    const Ns3AiMsgStats* GetStats()
+    {
+        return Stats();
+    };
+
+    /**
+     * Gets the latency in ns of a phase at the given percentile, or 0
+     * if the histograms are not enabled or the phase is out of range
+     */
+    uint64_t GetLatencyPercentile(uint32_t phase, double percentile)
+    {
+        if (!Stats() || phase >= NS3AI_PHASE_COUNT)
+        {
+            return 0;
+        }
+        return m_stats->m_phases[phase].GetPercentile(percentile);
+    };
+
+    /**
+     * Prints the latency histograms, if enabled
+     */
+    void DumpStats(std::ostream& os = std::cout)
+    {
+        if (Stats())
+        {
+            m_stats->Dump(os);
+        }
+    };
+
     // for C++ side:
 
     /**
@@ -191,7 +509,14 @@ class Ns3AiMsgInterfaceImpl
      */
     void CppSendBegin()
     {
-        Ns3AiSemaphore::sem_wait(&m_sync->m_cpp2pyEmptyCount);
+        Ns3AiSemaphore::sem_wait(&m_sync->m_cpp2py.m_emptyCount,
+                                 &m_sync->m_cpp2py.m_emptyWaiters,
+                                 m_waitPolicy,
+                                 m_spinCount);
+        if (Stats())
+        {
+            m_writeBeginTime = Now();
+        }
     };
 
     /**
@@ -200,7 +525,12 @@ class Ns3AiMsgInterfaceImpl
      */
     void CppSendEnd()
     {
-        Ns3AiSemaphore::sem_post(&m_sync->m_cpp2pyFullCount);
+        uint64_t sendTime =
+            SendEnd(m_sync->m_cpp2py, m_cpp2pyHeader, m_cpp2pyCursor, GetCpp2PyLength(), 0);
+        if (Stats() && m_writeBeginTime)
+        {
+            m_stats->m_phases[NS3AI_PHASE_CPP_WRITE].Record(sendTime - m_writeBeginTime);
+        }
     };
 
     /**
@@ -209,7 +539,11 @@ class Ns3AiMsgInterfaceImpl
      */
     void CppRecvBegin()
     {
-        Ns3AiSemaphore::sem_wait(&m_sync->m_py2cppFullCount);
+        Ns3AiSemaphore::sem_wait(&m_sync->m_py2cpp.m_fullCount,
+                                 &m_sync->m_py2cpp.m_fullWaiters,
+                                 m_waitPolicy,
+                                 m_spinCount);
+        RecvBegin(m_py2cppHeader[m_py2cppCursor], NS3AI_PHASE_CPP_WAKEUP);
     };
 
     /**
@@ -218,7 +552,7 @@ class Ns3AiMsgInterfaceImpl
      */
     void CppRecvEnd()
     {
-        Ns3AiSemaphore::sem_post(&m_sync->m_py2cppEmptyCount);
+        RecvEnd(m_sync->m_py2cpp, m_py2cppHeader, m_py2cppCursor, 1);
     };
 
     /**
@@ -230,8 +564,9 @@ class Ns3AiMsgInterfaceImpl
         assert(m_handleFinish);
         m_isFinished = true;
         CppSendBegin();
-        m_sync->m_isFinished = true;
-        CppSendEnd();
+        // the finish message is flagged in its header, so it is
+        // recognized even when queued behind others in a ring
+        SendEnd(m_sync->m_cpp2py, m_cpp2pyHeader, m_cpp2pyCursor, 0, NS3AI_MSG_FINISH);
     };
 
     // for Python side:
@@ -242,11 +577,58 @@ class Ns3AiMsgInterfaceImpl
      */
     void PyRecvBegin()
     {
-        Ns3AiSemaphore::sem_wait(&m_sync->m_cpp2pyFullCount);
-        if (m_handleFinish)
+        Ns3AiSemaphore::sem_wait(&m_sync->m_cpp2py.m_fullCount,
+                                 &m_sync->m_cpp2py.m_fullWaiters,
+                                 m_waitPolicy,
+                                 m_spinCount);
+        PyRecvSlot();
+    };
+
+    /**
+     * Python side starts reading if a message is available, and returns
+     * whether it did. Does not wait, so that one Python process can poll
+     * several simulations.
+     */
+    bool PyTryRecvBegin()
+    {
+        if (!Ns3AiSemaphore::sem_try_wait(&m_sync->m_cpp2py.m_fullCount))
+        {
+            return false;
+        }
+        PyRecvSlot();
+        return true;
+    };
+
+    /**
+     * Python side starts reading a batch of up to maxCount messages
+     * from a ring. Blocks until at least one message is available,
+     * then takes whatever else is already queued. Returns the number
+     * of messages in the batch, which are accessed with
+     * GetCpp2PyStructAt. Returns 0 if the simulation is over
+     * (when handling finish).
+     */
+    uint32_t PyRecvBeginBatch(uint32_t maxCount)
+    {
+        assert(maxCount >= 1 && maxCount <= m_ringDepth);
+        PyRecvBegin();
+        if (m_isFinished)
         {
-            m_isFinished = m_sync->m_isFinished;
+            return 0;
         }
+        uint32_t count = 1;
+        while (count < maxCount && Ns3AiSemaphore::sem_try_wait(&m_sync->m_cpp2py.m_fullCount))
+        {
+            Ns3AiMsgHeader& header = m_cpp2pyHeader[(m_cpp2pyCursor + count) % m_ringDepth];
+            if (m_handleFinish && (header.m_flags & NS3AI_MSG_FINISH))
+            {
+                // leave the finish message for the next PyRecvBegin
+                Ns3AiSemaphore::sem_post(&m_sync->m_cpp2py.m_fullCount);
+                break;
+            }
+            RecvBegin(header, NS3AI_PHASE_PY_WAKEUP);
+            ++count;
+        }
+        return count;
     };
 
     /**
@@ -255,7 +637,16 @@ class Ns3AiMsgInterfaceImpl
      */
     void PyRecvEnd()
     {
-        Ns3AiSemaphore::sem_post(&m_sync->m_cpp2pyEmptyCount);
+        PyRecvEndBatch(1);
+    };
+
+    /**
+     * Python side stops reading a batch of count messages
+     * started by PyRecvBeginBatch
+     */
+    void PyRecvEndBatch(uint32_t count)
+    {
+        RecvEnd(m_sync->m_cpp2py, m_cpp2pyHeader, m_cpp2pyCursor, count);
     };
 
     /**
@@ -264,7 +655,10 @@ class Ns3AiMsgInterfaceImpl
      */
     void PySendBegin()
     {
-        Ns3AiSemaphore::sem_wait(&m_sync->m_py2cppEmptyCount);
+        Ns3AiSemaphore::sem_wait(&m_sync->m_py2cpp.m_emptyCount,
+                                 &m_sync->m_py2cpp.m_emptyWaiters,
+                                 m_waitPolicy,
+                                 m_spinCount);
     };
 
     /**
@@ -273,7 +667,12 @@ class Ns3AiMsgInterfaceImpl
      */
     void PySendEnd()
     {
-        Ns3AiSemaphore::sem_post(&m_sync->m_py2cppFullCount);
+        uint64_t sendTime =
+            SendEnd(m_sync->m_py2cpp, m_py2cppHeader, m_py2cppCursor, GetPy2CppLength(), 0);
+        if (Stats() && m_lastRecvTime)
+        {
+            m_stats->m_phases[NS3AI_PHASE_PY_PROCESS].Record(sendTime - m_lastRecvTime);
+        }
     };
 
     /**
@@ -286,33 +685,239 @@ class Ns3AiMsgInterfaceImpl
     };
 
   private:
+    /**
+     * Name of the object describing a column, kept apart from
+     * the names of messages
+     */
+    static std::string ColumnKey(const std::string& name)
+    {
+        return "ns3ai column " + name;
+    };
+
+    /**
+     * Python side takes the C++ to Python slot it has acquired
+     */
+    void PyRecvSlot()
+    {
+        m_lastRecvTime = RecvBegin(m_cpp2pyHeader[m_cpp2pyCursor], NS3AI_PHASE_PY_WAKEUP);
+        if (m_handleFinish)
+        {
+            m_isFinished = m_cpp2pyHeader[m_cpp2pyCursor].m_flags & NS3AI_MSG_FINISH;
+        }
+    };
+
+    /**
+     * Steady clock time in nanoseconds, comparable between processes
+     */
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    };
+
+    /**
+     * Size of the block holding the synchronization structure and the
+     * message headers of both directions, with room for alignment
+     */
+    static std::size_t SyncBlockSize(uint32_t ringDepth)
+    {
+        return sizeof(Ns3AiMsgSync) + 2 * HeaderAreaSize(ringDepth) + NS3AI_CACHE_LINE;
+    };
+
+    /**
+     * Size of the headers of one direction, rounded up to whole cache lines
+     */
+    static std::size_t HeaderAreaSize(uint32_t ringDepth)
+    {
+        std::size_t size = ringDepth * sizeof(Ns3AiMsgHeader);
+        return (size + NS3AI_CACHE_LINE - 1) / NS3AI_CACHE_LINE * NS3AI_CACHE_LINE;
+    };
+
+    /**
+     * Locates the synchronization structure and the headers in the block.
+     * The segment is mapped at a page boundary in every process, so both
+     * sides align to the same place.
+     */
+    void SetSyncBlock(char* block)
+    {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(block);
+        addr = (addr + NS3AI_CACHE_LINE - 1) & ~uintptr_t(NS3AI_CACHE_LINE - 1);
+        char* base = reinterpret_cast<char*>(addr);
+        m_sync = reinterpret_cast<Ns3AiMsgSync*>(base);
+        base += sizeof(Ns3AiMsgSync);
+        m_cpp2pyHeader = reinterpret_cast<Ns3AiMsgHeader*>(base);
+        base += HeaderAreaSize(m_ringDepth);
+        m_py2cppHeader = reinterpret_cast<Ns3AiMsgHeader*>(base);
+    };
+
+    /**
+     * Payload length of a C++ to Python message
+     */
+    uint32_t GetCpp2PyLength() const
+    {
+        return m_useVector ? m_cpp2pyVector->size() * sizeof(Cpp2PyMsgType)
+                           : sizeof(Cpp2PyMsgType);
+    };
+
+    /**
+     * Payload length of a Python to C++ message
+     */
+    uint32_t GetPy2CppLength() const
+    {
+        return m_useVector ? m_py2cppVector->size() * sizeof(Py2CppMsgType)
+                           : sizeof(Py2CppMsgType);
+    };
+
+    /**
+     * Gets the latency histograms if enabled by either side
+     */
+    Ns3AiMsgStats* Stats()
+    {
+        if (!m_stats && m_sync->m_statsEnabled)
+        {
+            m_stats = m_segment.find<Ns3AiMsgStats>(NS3AI_STATS_NAME).first;
+        }
+        return m_stats;
+    };
+
+    /**
+     * Stamps a message as received, records its wake-up latency,
+     * and returns the receive time
+     */
+    uint64_t RecvBegin(Ns3AiMsgHeader& header, Ns3AiMsgPhase phase)
+    {
+        uint64_t recvTime = Now();
+        header.m_recvTime = recvTime;
+        if (Stats())
+        {
+            m_stats->m_phases[phase].Record(recvTime - header.m_sendTime);
+        }
+        return recvTime;
+    };
+
+    /**
+     * Fills the header of the message in the current slot and
+     * passes it to the receiver. Returns the send time.
+     */
+    uint64_t SendEnd(Ns3AiMsgQueueSync& queue,
+                     Ns3AiMsgHeader* headers,
+                     uint32_t& cursor,
+                     uint32_t length,
+                     uint32_t flags)
+    {
+        Ns3AiMsgHeader& header = headers[cursor];
+        // only this side writes the send sequence number
+        uint64_t seq = queue.m_sendSeq + 1;
+        header.m_seq = seq;
+        header.m_length = length;
+        header.m_flags = flags;
+        uint64_t sendTime = Now();
+        header.m_sendTime = sendTime;
+        queue.m_sendSeq = seq;
+        cursor = (cursor + 1) % m_ringDepth;
+        // posting is a full barrier, so the header is visible before the message
+        Ns3AiSemaphore::sem_post(&queue.m_fullCount, &queue.m_fullWaiters);
+        return sendTime;
+    };
+
+    /**
+     * Releases count received messages starting from the current slot
+     */
+    void RecvEnd(Ns3AiMsgQueueSync& queue,
+                 Ns3AiMsgHeader* headers,
+                 uint32_t& cursor,
+                 uint32_t count)
+    {
+        queue.m_recvSeq = headers[(cursor + count - 1) % m_ringDepth].m_seq;
+        cursor = (cursor + count) % m_ringDepth;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Ns3AiSemaphore::sem_post(&queue.m_emptyCount, &queue.m_emptyWaiters);
+        }
+    };
+
+    boost::interprocess::managed_shared_memory m_segment;
     Cpp2PyMsgType* m_cpp2pyStruct;
     Py2CppMsgType* m_py2CppStruct;
     Cpp2PyMsgVector* m_cpp2pyVector;
     Py2CppMsgVector* m_py2cppVector;
 
     Ns3AiMsgSync* m_sync;
+    Ns3AiMsgHeader* m_cpp2pyHeader; //!< headers of the C++ to Python ring
+    Ns3AiMsgHeader* m_py2cppHeader; //!< headers of the Python to C++ ring
+    uint32_t m_ringDepth;
+    uint32_t m_cpp2pyCursor; //!< current slot in C++ to Python ring on this side
+    uint32_t m_py2cppCursor; //!< current slot in Python to C++ ring on this side
     const bool m_isCreator;
     const bool m_useVector;
     const bool m_handleFinish;
     const std::string m_segName;
+    const Ns3AiWaitPolicy m_waitPolicy;
+    const uint32_t m_spinCount;
     bool m_isFinished;
+    Ns3AiMsgStats* m_stats;
+    bool m_dumpStats;
+    uint64_t m_writeBeginTime; //!< when C++ side started writing the current message
+    uint64_t m_lastRecvTime;   //!< when Python side received the last message
+};
+
+/**
+ * \brief Settings of a channel of Ns3AiMsgInterface, see its setters
+ */
+struct Ns3AiMsgChannelSettings
+{
+    bool m_isMemoryCreator = false;
+    bool m_useVector = false;
+    bool m_handleFinish = false;
+    uint32_t m_size = 4096;
+    Ns3AiWaitPolicy m_waitPolicy = NS3AI_WAIT_SPIN;
+    uint32_t m_spinCount = NS3AI_DEFAULT_SPIN_COUNT;
+    uint32_t m_ringDepth = 1;
+    bool m_statsEnabled = false;
+    std::string m_cpp2pyMsgName = "My Cpp to Python Msg";
+    std::string m_py2cppMsgName = "My Python to Cpp Msg";
+    std::string m_lockableName = "My Lockable";
 };
 
 /**
  * \brief The message interface, a singleton class
+ *
+ * It keeps a registry of channels. Each channel lives in its own
+ * shared memory segment, has its own synchronization block and sizes,
+ * and is keyed by the segment name. Settings made with the setters
+ * apply to channels created afterwards by GetInterface.
  */
 
 class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
 {
   public:
+    /**
+     * The default segment name is taken from the NS3AI_SEGMENT_NAME
+     * environment variable if it is set. Python side sets it when it
+     * runs several simulations at once, each with its own segment.
+     */
+    Ns3AiMsgInterface()
+        : m_segmentName(GetDefaultSegmentName())
+    {
+    };
+
+    /**
+     * Gets the segment name before any SetNames
+     */
+    static std::string GetDefaultSegmentName()
+    {
+        const char* segmentName = std::getenv("NS3AI_SEGMENT_NAME");
+        return segmentName && *segmentName ? segmentName : "My Seg";
+    };
+
     /**
      * Sets if this side (C++ or Python) is the memory creator.
      * Configuration on two sides must be different
      */
     void SetIsMemoryCreator(bool isMemoryCreator)
     {
-        this->m_isMemoryCreator = isMemoryCreator;
+        this->m_settings.m_isMemoryCreator = isMemoryCreator;
     };
 
     /**
@@ -321,7 +926,7 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
      */
     void SetUseVector(bool useVector)
     {
-        this->m_useVector = useVector;
+        this->m_settings.m_useVector = useVector;
     };
 
     /**
@@ -330,7 +935,38 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
      */
     void SetHandleFinish(bool handleFinish)
     {
-        this->m_handleFinish = handleFinish;
+        this->m_settings.m_handleFinish = handleFinish;
+    };
+
+    /**
+     * Sets how this side waits for the other side. NS3AI_WAIT_SPIN
+     * busy-spins and has the lowest latency. NS3AI_WAIT_HYBRID spins
+     * for spinCount probes, then blocks on a futex so that the core
+     * is released while the other side is busy. Configuration on two
+     * sides can be different.
+     */
+    void SetWaitPolicy(Ns3AiWaitPolicy policy, uint32_t spinCount = NS3AI_DEFAULT_SPIN_COUNT)
+    {
+        this->m_settings.m_waitPolicy = policy;
+        this->m_settings.m_spinCount = spinCount;
+    };
+
+    /**
+     * Sets the number of message slots per direction of struct-based
+     * interface, only valid for the shared memory creator.
+     */
+    void SetRingDepth(uint32_t ringDepth)
+    {
+        this->m_settings.m_ringDepth = ringDepth;
+    };
+
+    /**
+     * Sets if latency histograms of the round trip phases are
+     * recorded, and printed when the channel is destroyed
+     */
+    void SetStatsEnabled(bool statsEnabled)
+    {
+        this->m_settings.m_statsEnabled = statsEnabled;
     };
 
     /**
@@ -340,7 +976,7 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
      */
     void SetMemorySize(uint32_t size)
     {
-        this->m_size = size;
+        this->m_settings.m_size = size;
     };
 
     /**
@@ -354,39 +990,102 @@ class Ns3AiMsgInterface : public Singleton<Ns3AiMsgInterface>
                   std::string lockableName)
     {
         this->m_segmentName = segmentName;
-        this->m_cpp2pyMsgName = cpp2pyMsgName;
-        this->m_py2cppMsgName = py2cppMsgName;
-        this->m_lockableName = lockableName;
+        this->m_settings.m_cpp2pyMsgName = cpp2pyMsgName;
+        this->m_settings.m_py2cppMsgName = py2cppMsgName;
+        this->m_settings.m_lockableName = lockableName;
+    };
+
+    /**
+     * Gets the settings that channels created by GetInterface
+     * without settings use
+     */
+    const Ns3AiMsgChannelSettings& GetSettings() const
+    {
+        return this->m_settings;
     };
 
     /**
      * Gets the impl which has semaphore (synchronization)
-     * methods
+     * methods, for the channel in the segment set by SetNames
      */
     template <typename Cpp2PyMsgType, typename Py2CppMsgType>
     Ns3AiMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType>* GetInterface()
     {
-        static Ns3AiMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType> interface(
-            this->m_isMemoryCreator,
-            this->m_useVector,
-            this->m_handleFinish,
-            this->m_size,
-            this->m_segmentName.c_str(),
-            this->m_cpp2pyMsgName.c_str(),
-            this->m_py2cppMsgName.c_str(),
-            this->m_lockableName.c_str());
-        return &interface;
+        return GetInterface<Cpp2PyMsgType, Py2CppMsgType>(this->m_segmentName);
+    };
+
+    /**
+     * Gets the impl for the channel in the given segment. The
+     * channel is created with the current settings on first use,
+     * and later calls return the same channel. The message types
+     * of a channel cannot change.
+     */
+    template <typename Cpp2PyMsgType, typename Py2CppMsgType>
+    Ns3AiMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType>* GetInterface(
+        const std::string& segmentName)
+    {
+        return GetInterface<Cpp2PyMsgType, Py2CppMsgType>(segmentName, this->m_settings);
+    };
+
+    /**
+     * Gets the impl for the channel in the given segment, created
+     * with the given settings instead of the current ones on first
+     * use. A module that owns a channel uses it so that the setters
+     * called for other channels do not affect it.
+     */
+    template <typename Cpp2PyMsgType, typename Py2CppMsgType>
+    Ns3AiMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType>* GetInterface(
+        const std::string& segmentName,
+        const Ns3AiMsgChannelSettings& settings)
+    {
+        typedef Ns3AiMsgInterfaceImpl<Cpp2PyMsgType, Py2CppMsgType> Impl;
+        auto it = m_channels.find(segmentName);
+        if (it == m_channels.end())
+        {
+            std::shared_ptr<Impl> impl = std::make_shared<Impl>(settings.m_isMemoryCreator,
+                                                                settings.m_useVector,
+                                                                settings.m_handleFinish,
+                                                                settings.m_size,
+                                                                segmentName.c_str(),
+                                                                settings.m_cpp2pyMsgName.c_str(),
+                                                                settings.m_py2cppMsgName.c_str(),
+                                                                settings.m_lockableName.c_str(),
+                                                                settings.m_waitPolicy,
+                                                                settings.m_spinCount,
+                                                                settings.m_ringDepth);
+            if (settings.m_statsEnabled)
+            {
+                impl->EnableStats(true);
+            }
+            it = m_channels.emplace(segmentName, Channel{typeid(Impl), impl}).first;
+        }
+        assert(it->second.type == typeid(Impl));
+        return static_cast<Impl*>(it->second.impl.get());
+    };
+
+    /**
+     * Destroys the channel in the given segment, which notifies
+     * the other side if finish is handled
+     */
+    void RemoveInterface(const std::string& segmentName)
+    {
+        m_channels.erase(segmentName);
     };
 
   private:
-    bool m_isMemoryCreator;
-    bool m_useVector;
-    bool m_handleFinish;
-    uint32_t m_size = 4096;
-    std::string m_segmentName = "My Seg";
-    std::string m_cpp2pyMsgName = "My Cpp to Python Msg";
-    std::string m_py2cppMsgName = "My Python to Cpp Msg";
-    std::string m_lockableName = "My Lockable";
+    /**
+     * \brief A type-erased channel in the registry
+     */
+    struct Channel
+    {
+        std::type_index type;
+        std::shared_ptr<void> impl;
+    };
+
+    std::unordered_map<std::string, Channel> m_channels;
+
+    Ns3AiMsgChannelSettings m_settings; //!< of channels created by GetInterface without settings
+    std::string m_segmentName;          //!< of GetInterface without a segment name
 };
 
 } // namespace ns3
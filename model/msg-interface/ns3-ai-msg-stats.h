@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2023 Huazhong University of Science and Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors:  Muyuan Shen <muyuan_shen@hust.edu.cn>
+ */
+
+#ifndef NS3_AI_MSG_STATS_H
+#define NS3_AI_MSG_STATS_H
+
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+
+/**
+ * \brief Number of linear sub-buckets per power of two in a latency
+ * histogram, which bounds the relative error to 1/16
+ */
+#define NS3AI_HIST_SUB_BUCKETS 16
+
+/**
+ * \brief Number of buckets in a latency histogram, covering
+ * latencies up to 2^40 ns (about 18 minutes)
+ */
+#define NS3AI_HIST_BUCKETS 592
+
+/**
+ * \brief Name of the latency histograms in the shared memory segment
+ */
+#define NS3AI_STATS_NAME "ns3ai stats"
+
+namespace ns3
+{
+
+/**
+ * \brief Phases of a round trip measured by the message interface
+ */
+enum Ns3AiMsgPhase : uint32_t
+{
+    NS3AI_PHASE_CPP_WRITE = 0,  //!< CppSendBegin returns to CppSendEnd
+    NS3AI_PHASE_PY_WAKEUP = 1,  //!< CppSendEnd to PyRecvBegin returns
+    NS3AI_PHASE_PY_PROCESS = 2, //!< PyRecvBegin returns to PySendEnd
+    NS3AI_PHASE_CPP_WAKEUP = 3, //!< PySendEnd to CppRecvBegin returns
+    NS3AI_PHASE_COUNT = 4,
+};
+
+/**
+ * \brief Log-linear latency histogram in nanoseconds, in the style of
+ * HdrHistogram. Latencies below 32 ns have exact buckets; above that,
+ * every power of two is split into NS3AI_HIST_SUB_BUCKETS buckets.
+ * Only one process records into a histogram.
+ */
+struct Ns3AiLatencyHistogram
+{
+    uint64_t m_counts[NS3AI_HIST_BUCKETS];
+    uint64_t m_total;
+    uint64_t m_sum;
+    uint64_t m_min;
+    uint64_t m_max;
+
+    static uint32_t BucketOf(uint64_t ns)
+    {
+        if (ns < 2 * NS3AI_HIST_SUB_BUCKETS)
+        {
+            return ns;
+        }
+        uint32_t exp = 63 - __builtin_clzll(ns);
+        uint32_t index =
+            (exp - 3) * NS3AI_HIST_SUB_BUCKETS + ((ns >> (exp - 4)) & (NS3AI_HIST_SUB_BUCKETS - 1));
+        return index < NS3AI_HIST_BUCKETS ? index : NS3AI_HIST_BUCKETS - 1;
+    };
+
+    static uint64_t BucketLowerBound(uint32_t index)
+    {
+        if (index < 2 * NS3AI_HIST_SUB_BUCKETS)
+        {
+            return index;
+        }
+        uint32_t exp = index / NS3AI_HIST_SUB_BUCKETS + 3;
+        uint64_t mantissa = NS3AI_HIST_SUB_BUCKETS + index % NS3AI_HIST_SUB_BUCKETS;
+        return mantissa << (exp - 4);
+    };
+
+    void Record(uint64_t ns)
+    {
+        ++m_counts[BucketOf(ns)];
+        m_min = (m_total == 0 || ns < m_min) ? ns : m_min;
+        m_max = ns > m_max ? ns : m_max;
+        m_sum += ns;
+        ++m_total;
+    };
+
+    /**
+     * Gets the latency in ns below which the given percentage of
+     * samples fall, within the bucket resolution
+     */
+    uint64_t GetPercentile(double percentile) const
+    {
+        if (m_total == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = percentile / 100.0 * m_total;
+        rank = rank < 1 ? 1 : rank;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < NS3AI_HIST_BUCKETS; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= rank)
+            {
+                uint64_t upper = BucketLowerBound(i + 1) - 1;
+                return upper < m_max ? upper : m_max;
+            }
+        }
+        return m_max;
+    };
+
+    double GetMean() const
+    {
+        return m_total ? static_cast<double>(m_sum) / m_total : 0;
+    };
+};
+
+/**
+ * \brief Latency histograms of all phases, kept in the shared memory
+ * segment so that both sides can read them
+ */
+struct Ns3AiMsgStats
+{
+    Ns3AiLatencyHistogram m_phases[NS3AI_PHASE_COUNT];
+
+    void Dump(std::ostream& os) const
+    {
+        static const char* names[NS3AI_PHASE_COUNT] = {"C++ write",
+                                                       "Python wake-up",
+                                                       "Python processing",
+                                                       "C++ wake-up"};
+        os << "ns3-ai message interface latency (us):\n";
+        os << std::left << std::setw(20) << "phase" << std::right << std::setw(10) << "count"
+           << std::setw(10) << "min" << std::setw(10) << "mean" << std::setw(10) << "p50"
+           << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+           << std::setw(10) << "max" << "\n";
+        os << std::fixed << std::setprecision(2);
+        for (uint32_t i = 0; i < NS3AI_PHASE_COUNT; ++i)
+        {
+            const Ns3AiLatencyHistogram& hist = m_phases[i];
+            os << std::left << std::setw(20) << names[i] << std::right << std::setw(10)
+               << hist.m_total << std::setw(10) << hist.m_min / 1e3 << std::setw(10)
+               << hist.GetMean() / 1e3 << std::setw(10) << hist.GetPercentile(50) / 1e3
+               << std::setw(10) << hist.GetPercentile(90) / 1e3 << std::setw(10)
+               << hist.GetPercentile(99) / 1e3 << std::setw(10) << hist.GetPercentile(99.9) / 1e3
+               << std::setw(10) << hist.m_max / 1e3 << "\n";
+        }
+        os << std::defaultfloat;
+    };
+};
+
+} // namespace ns3
+
+#endif // NS3_AI_MSG_STATS_H
@@ -20,65 +20,164 @@
 #ifndef NS3_AI_SEMAPHORE_H
 #define NS3_AI_SEMAPHORE_H
 
+#include <climits>
 #include <cstdint>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <time.h>
+#endif
+
+/**
+ * \brief Number of probes a hybrid waiter spins before it blocks.
+ * At a few tens of nanoseconds per probe, this keeps quick replies
+ * on the spinning fast path.
+ */
+#define NS3AI_DEFAULT_SPIN_COUNT 4096
+
+/**
+ * \brief How a side waits for its peer to post a semaphore
+ */
+enum Ns3AiWaitPolicy : uint32_t
+{
+    NS3AI_WAIT_SPIN = 0,   //!< Busy-spin until the peer posts (lowest latency, one core busy)
+    NS3AI_WAIT_HYBRID = 1, //!< Spin for a bounded number of probes, then block on a futex
+};
 
 /**
  * \brief Structure providing semaphore operations
+ *
+ * Semaphores are 32-bit counters so that they can double as futex words.
+ * Each counter is paired with a waiter count, which is nonzero while the
+ * peer is (about to be) blocked in the kernel and must be woken on post.
  */
 struct Ns3AiSemaphore
 {
     explicit Ns3AiSemaphore() = default;
 
-    static inline uint8_t atomic_read8(const volatile uint8_t* mem)
+    static inline void cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
+    static inline uint32_t atomic_read32(const volatile uint32_t* mem)
     {
-        uint8_t old_val = *mem;
+        uint32_t old_val = *mem;
         __sync_synchronize();
         return old_val;
     }
 
-    static inline uint8_t atomic_cas8(volatile uint8_t* mem, uint8_t with, uint8_t cmp)
+    static inline uint32_t atomic_cas32(volatile uint32_t* mem, uint32_t with, uint32_t cmp)
     {
-        return __sync_val_compare_and_swap(const_cast<uint8_t*>(mem), cmp, with);
+        return __sync_val_compare_and_swap(const_cast<uint32_t*>(mem), cmp, with);
     }
 
-    static inline uint8_t atomic_add8(volatile uint8_t* mem, uint8_t val)
+    static inline uint32_t atomic_add32(volatile uint32_t* mem, uint32_t val)
     {
-        return __sync_fetch_and_add(const_cast<uint8_t*>(mem), val);
+        return __sync_fetch_and_add(const_cast<uint32_t*>(mem), val);
     }
 
-    static inline bool atomic_add_unless8(volatile uint8_t* mem, uint8_t value, uint8_t unless_this)
+    static inline bool atomic_add_unless32(volatile uint32_t* mem,
+                                           uint32_t value,
+                                           uint32_t unless_this)
     {
-        uint8_t old;
-        uint8_t c(atomic_read8(mem));
-        while (c != unless_this && (old = atomic_cas8(mem, c + value, c)) != c)
+        uint32_t old;
+        uint32_t c(atomic_read32(mem));
+        while (c != unless_this && (old = atomic_cas32(mem, c + value, c)) != c)
         {
             c = old;
         }
         return c != unless_this;
     }
 
-    static inline bool sem_try_wait(volatile uint8_t* mem)
+    /**
+     * Blocks while *mem equals expected. May return spuriously.
+     */
+    static inline void futex_wait(volatile uint32_t* mem, uint32_t expected)
+    {
+#if defined(__linux__)
+        // no FUTEX_PRIVATE_FLAG: the word lives in memory shared between processes
+        syscall(SYS_futex, const_cast<uint32_t*>(mem), FUTEX_WAIT, expected, nullptr, nullptr, 0);
+#else
+        // no futex outside Linux: nap briefly instead of spinning
+        (void)mem;
+        (void)expected;
+        struct timespec ts = {0, 50000};
+        nanosleep(&ts, nullptr);
+#endif
+    }
+
+    static inline void futex_wake(volatile uint32_t* mem)
+    {
+#if defined(__linux__)
+        syscall(SYS_futex, const_cast<uint32_t*>(mem), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+        (void)mem;
+#endif
+    }
+
+    static inline bool sem_try_wait(volatile uint32_t* mem)
+    {
+        return atomic_add_unless32(mem, -1, 0);
+    }
+
+    static inline void sem_wait(volatile uint32_t* mem)
     {
-        return atomic_add_unless8(mem, -1, 0);
+        // probe with a plain load and only pay for the CAS when a post is visible
+        while (!(*mem != 0 && sem_try_wait(mem)))
+        {
+            cpu_relax();
+        }
     }
 
-    static inline void sem_wait(volatile uint8_t* mem)
+    static inline void sem_wait(volatile uint32_t* mem,
+                                volatile uint32_t* waiters,
+                                Ns3AiWaitPolicy policy,
+                                uint32_t spin_count)
     {
-        if (!sem_try_wait(mem))
+        if (policy == NS3AI_WAIT_SPIN)
+        {
+            sem_wait(mem);
+            return;
+        }
+        for (uint32_t i = 0; i < spin_count; ++i)
         {
-            do
+            if (*mem != 0 && sem_try_wait(mem))
             {
-                if (sem_try_wait(mem))
-                {
-                    break;
-                }
-            } while (true);
+                return;
+            }
+            cpu_relax();
+        }
+        while (!sem_try_wait(mem))
+        {
+            // Register as waiter before sleeping. The poster increments the counter
+            // before it reads the waiter count, so either it sees us and wakes us,
+            // or the kernel sees the new count and does not put us to sleep.
+            atomic_add32(waiters, 1);
+            futex_wait(mem, 0);
+            atomic_add32(waiters, -1);
         }
     }
 
-    static inline uint8_t sem_post(volatile uint8_t* mem)
+    static inline uint32_t sem_post(volatile uint32_t* mem)
+    {
+        return atomic_add32(mem, 1);
+    }
+
+    static inline uint32_t sem_post(volatile uint32_t* mem, volatile uint32_t* waiters)
     {
-        return atomic_add8(mem, 1);
+        uint32_t old = atomic_add32(mem, 1);
+        if (atomic_read32(waiters) != 0)
+        {
+            futex_wake(mem);
+        }
+        return old;
     }
 };
 
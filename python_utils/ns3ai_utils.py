@@ -17,7 +17,10 @@
 #         Hao Yin <haoyin@uw.edu>
 #         Muyuan Shen <muyuan_shen@hust.edu.cn>
 
+import ast
 import os
+import re
+import shlex
 import subprocess
 import psutil
 import time
@@ -25,6 +28,17 @@ import signal
 
 
 SIMULATION_EARLY_ENDING = 0.5   # wait and see if the subprocess is running after creation
+SIMULATION_READY_POLL = 0.001   # interval between checks of whether the simulation is up
+
+# wait policies of the message interface, see ns3-ai-semaphore.h
+WAIT_POLICIES = {
+    'spin': 0,      # busy-spin until the other side posts (lowest latency)
+    'hybrid': 1,    # spin for a bounded number of probes, then block on a futex
+}
+DEFAULT_SPIN_COUNT = 4096
+
+# suffixes of executables built by ns-3, one per build profile
+BUILD_PROFILES = ('default', 'debug', 'release', 'optimized', 'minsizerel')
 
 
 def get_setting(setting_map):
@@ -34,27 +48,61 @@ def get_setting(setting_map):
     return ret
 
 
-def run_single_ns3(path, pname, setting=None, env=None, show_output=False):
-    if env is None:
-        env = {}
-    env.update(os.environ)
-    env['LD_LIBRARY_PATH'] = os.path.abspath(os.path.join(path, 'build', 'lib'))
+# finds the executable of target pname in the list of runnable programs written by ns3
+# configure, such as build/examples/ns3.40-pname-default. Returns None if it is not built.
+def find_ns3_program(path, pname):
+    try:
+        with open(os.path.join(path, 'build', 'build-status.py')) as f:
+            status = ast.parse(f.read())
+    except (OSError, SyntaxError):
+        return None
+    programs = []
+    for node in status.body:
+        if (isinstance(node, ast.Assign) and len(node.targets) == 1 and
+                getattr(node.targets[0], 'id', None) == 'ns3_runnable_programs'):
+            programs = ast.literal_eval(node.value)
+    # the target may be prefixed by its directory, like with ns3 run
+    directory, name = os.path.split(pname)
+    pattern = re.compile(r'ns3(\.\d+)*(-dev)?-{}(-({}))?$'.format(
+        re.escape(name), '|'.join(BUILD_PROFILES)))
+    for program in programs:
+        program = os.path.join(path, program)
+        if (pattern.match(os.path.basename(program)) and
+                os.path.dirname(program).endswith(directory) and
+                os.access(program, os.X_OK)):
+            return program
+    return None
+
+
+# runs target pname of the ns-3 tree at path. Without build, the executable is run directly
+# if it can be found, which skips the ns3 script and its build check.
+def run_single_ns3(path, pname, setting=None, env=None, show_output=False, build=True):
+    # variables given by the caller take precedence
+    env = dict(os.environ, **(env or {}))
+    # the libraries of the tree come first, then the ones the caller relies on
+    lib_path = os.path.abspath(os.path.join(path, 'build', 'lib'))
+    if env.get('LD_LIBRARY_PATH'):
+        lib_path += os.pathsep + env['LD_LIBRARY_PATH']
+    env['LD_LIBRARY_PATH'] = lib_path
     # import pdb; pdb.set_trace()
-    exec_path = os.path.join(path, 'ns3')
-    if not setting:
-        cmd = '{} run {}'.format(exec_path, pname)
+    program = None if build else find_ns3_program(path, pname)
+    if program:
+        args = [program] + ['--{}={}'.format(key, value)
+                            for key, value in (setting or {}).items()]
+        cmd = shlex.join(args)
     else:
-        cmd = '{} run {} --{}'.format(exec_path, pname, get_setting(setting))
-    if show_output:
-        proc = subprocess.Popen(cmd, shell=True, text=True, env=env,
-                                stdin=subprocess.PIPE,
-                                preexec_fn=os.setpgrp)
-    else:
-        proc = subprocess.Popen(cmd, shell=True, text=True, env=env,
-                                stdin=subprocess.PIPE,
-                                stdout=subprocess.PIPE,
-                                stderr=subprocess.PIPE,
-                                preexec_fn=os.setpgrp)
+        exec_path = os.path.join(path, 'ns3')
+        run_cmd = 'run' if build else 'run --no-build'
+        if not setting:
+            cmd = '{} {} {}'.format(exec_path, run_cmd, pname)
+        else:
+            cmd = '{} {} {} --{}'.format(exec_path, run_cmd, pname, get_setting(setting))
+        args = cmd
+    output = {} if show_output else {'stdout': subprocess.PIPE, 'stderr': subprocess.PIPE}
+    proc = subprocess.Popen(args, shell=not program, text=True, env=env, cwd=path,
+                            stdin=subprocess.PIPE,
+                            preexec_fn=os.setpgrp,
+                            **output)
 
     return cmd, proc
 
@@ -92,13 +140,20 @@ def sigint_handler(sig, frame):
 
 
 # This class sets up the shared memory and runs the simulation process.
+# Several experiments can run at once if their segment names differ. The
+# simulation gets the segment name in the NS3AI_SEGMENT_NAME environment
+# variable, which is the default segment name of Ns3AiMsgInterface.
 class Experiment:
-    _created = False
-
     # init ns-3 environment
     # \param[in] memSize : share memory size
     # \param[in] targetName : program name of ns3
     # \param[in] path : current working directory
+    # \param[in] waitPolicy : 'spin' or 'hybrid', how Python side waits for C++ side
+    # \param[in] spinCount : number of probes before blocking, for 'hybrid' only
+    # \param[in] ringDepth : number of message slots per direction, struct-based only
+    # \param[in] enableStats : whether to record latency histograms and print them at exit
+    # \param[in] reservedSize : bytes of the segment kept for columns declared later, for
+    #                           bindings whose messages take the rest of the segment
     def __init__(self, targetName, ns3Path, msgModule,
                  handleFinish=False,
                  useVector=False, vectorSize=None,
@@ -106,12 +161,14 @@ class Experiment:
                  segName="My Seg",
                  cpp2pyMsgName="My Cpp to Python Msg",
                  py2cppMsgName="My Python to Cpp Msg",
-                 lockableName="My Lockable"):
-        if self._created:
-            raise Exception('ns3ai_utils: Error: Experiment is singleton')
-        self._created = True
+                 lockableName="My Lockable",
+                 waitPolicy='spin',
+                 spinCount=DEFAULT_SPIN_COUNT,
+                 ringDepth=1,
+                 enableStats=False,
+                 reservedSize=0):
         self.targetName = targetName  # ns-3 target name, not file name
-        os.chdir(ns3Path)
+        self.ns3Path = os.path.abspath(ns3Path)
         self.msgModule = msgModule
         self.handleFinish = handleFinish
         self.useVector = useVector
@@ -121,11 +178,24 @@ class Experiment:
         self.cpp2pyMsgName = cpp2pyMsgName
         self.py2cppMsgName = py2cppMsgName
         self.lockableName = lockableName
+        if waitPolicy not in WAIT_POLICIES:
+            raise Exception('ns3ai_utils: Error: Unknown wait policy {}'.format(waitPolicy))
+        self.waitPolicy = waitPolicy
+        self.spinCount = spinCount
+        if ringDepth < 1 or (useVector and ringDepth != 1):
+            raise Exception('ns3ai_utils: Error: Invalid ring depth {}'.format(ringDepth))
+        self.ringDepth = ringDepth
+        self.enableStats = enableStats
 
+        # only bindings that take it know the reserved size
+        reserved = {'reserved': reservedSize} if reservedSize else {}
         self.msgInterface = msgModule.Ns3AiMsgInterfaceImpl(
             True, self.useVector, self.handleFinish,
-            self.shmSize, self.segName, self.cpp2pyMsgName, self.py2cppMsgName, self.lockableName
+            self.shmSize, self.segName, self.cpp2pyMsgName, self.py2cppMsgName, self.lockableName,
+            WAIT_POLICIES[self.waitPolicy], self.spinCount, self.ringDepth, **reserved
         )
+        if self.enableStats:
+            self.msgInterface.EnableStats()
         if self.useVector:
             if self.vectorSize is None:
                 raise Exception('ns3ai_utils: Error: Using vector but size is unknown')
@@ -134,29 +204,59 @@ class Experiment:
 
         self.proc = None
         self.simCmd = None
+        self.built = False
+        self.attachCount = None
         print('ns3ai_utils: Experiment initialized')
 
     def __del__(self):
         self.kill()
+        if self.enableStats:
+            self.msgInterface.DumpStats()
         del self.msgInterface
         print('ns3ai_utils: Experiment destroyed')
 
     # run ns3 script in cmd with the setting being input
     # \param[in] setting : ns3 script input parameters(default : None)
     # \param[in] show_output : whether to show output or not(default : False)
-    def run(self, setting=None, show_output=False):
+    # \param[in] build : whether ns3 builds the target before running it, which is done on the
+    #                    first run only, later runs start the executable directly(default : True)
+    # \param[in] wait : whether to wait until the simulation opens the segment, and exit if it
+    #                   dies before(default : True)
+    def run(self, setting=None, show_output=False, build=True, wait=True):
         self.kill()
+        # the simulation is up once it has opened the segment
+        self.attachCount = self._get_attach_count()
         self.simCmd, self.proc = run_single_ns3(
-            './', self.targetName, setting=setting, show_output=show_output)
+            self.ns3Path, self.targetName, setting=setting,
+            env={'NS3AI_SEGMENT_NAME': self.segName}, show_output=show_output,
+            build=build and not self.built)
+        self.built = True
         print("ns3ai_utils: Running ns-3 with: ", self.simCmd)
         # exit if an early error occurred, such as wrong target name
-        time.sleep(SIMULATION_EARLY_ENDING)
-        if not self.isalive():
-            print('ns3ai_utils: Subprocess died very early')
-            exit(1)
+        if wait:
+            if self.attachCount is None:
+                time.sleep(SIMULATION_EARLY_ENDING)
+                ready = False
+            else:
+                while not self.isready() and self.isalive():
+                    time.sleep(SIMULATION_READY_POLL)
+                ready = self.isready()
+            if not ready and not self.isalive():
+                print('ns3ai_utils: Subprocess died very early')
+                exit(1)
         signal.signal(signal.SIGINT, sigint_handler)
         return self.msgInterface
 
+    # whether the simulation has opened the segment since the last run. Always true for
+    # bindings without GetAttachCount
+    def isready(self):
+        return self.attachCount is None or self._get_attach_count() != self.attachCount
+
+    def _get_attach_count(self):
+        if not hasattr(self.msgInterface, 'GetAttachCount'):
+            return None
+        return self.msgInterface.GetAttachCount()
+
     def kill(self):
         if self.proc and self.isalive():
             kill_proc_tree(self.proc)